@@ -0,0 +1,444 @@
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "fitz.h"
+
+#define BENCH_SECONDS 0.1 // Least time to run each benchmark for by default
+#define BENCH_TILES 32 // Tiles in the tile set played with
+#define LOAD_TILES 4096 // Tiles in the tile file read by read_file
+#define LIBRARY_TILES 262144 // Tiles in the tile library read by load_tiles
+#define ANCHORS 4096 // Random anchors tried by valid_place
+#define MOVES 256 // Most legal moves put and taken by put_tile
+#define SCALING_CELLS (1 << 16) // Boards big enough to scan in parallel
+#define SCALING_STEPS 3 // Parallel scans are timed on 2, 4 and 8 threads
+#define SEED 0x2545F4914F6CDD1DULL // Every run generates the same workloads
+
+/* A position to benchmark, and what the benchmarks need to run on it */
+typedef struct {
+    AllTiles* tiles;
+    Board* board;
+    double fill; // Fraction of cells filled
+    Game game; // Loaded into by load_game
+    char* path; // The save file
+    char* binaryPath; // The binary save file
+    FILE* sink; // Printed to by print_board
+    FILE* tileFile; // Read by read_file
+    char* libraryPath; // The large tile file read by load_tiles
+    Move anchors[ANCHORS]; // Random anchors and rotations
+    Move moves[MOVES]; // Legal moves
+    int moveCount;
+    ScanPool* pool; // Threads scanning for game_end2, or NULL for none
+    int threads; // The threads scanning, counting the one starting scans
+    ScanPool* pools[SCALING_STEPS]; // Of 2, 4 and 8 threads
+} Bench;
+
+/* A benchmark: run ops operations and return something to keep */
+typedef long (*BenchRun)(Bench* bench, long ops);
+
+long allocations = 0; // Calls to malloc, calloc and realloc so far
+double benchSeconds = BENCH_SECONDS;
+long sink = 0; // Results of the benchmarks, so none are optimised away
+
+/*
+ * The linker sends the engine's allocations here (-Wl,--wrap=malloc etc.),
+ * so that they can be counted
+ */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size) {
+    allocations++;
+    return __real_realloc(pointer, size);
+}
+
+/*
+ * Get the next number of a fixed pseudo-random sequence (xorshift64*)
+ * Param: state - the state of the sequence, updated
+ * Return: the number
+ */
+uint64_t bench_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * Write a tile file of random tiles, each with at least its middle filled
+ * Param: file - the file to write to, or NULL to write to a temporary file
+ *        count - the number of tiles
+ *        random - the random number state
+ * Return: the file, at its start, or NULL if it can't be written
+ */
+FILE* generate_tiles(FILE* file, int count, uint64_t* random) {
+    file = file ? file : tmpfile();
+    if (file == NULL) {
+        return NULL;
+    }
+    for (int t = 0; t < count; t++) {
+        for (int row = 0; row < TILE_SIZE; row++) {
+            for (int column = 0; column < TILE_SIZE; column++) {
+                int exist = (row == MIDDLE && column == MIDDLE) ||
+                        bench_random(random) % 5 < 2;
+                fputc(exist ? TILE_EXIST : TILE_EMPTY, file);
+            }
+            fputc('\n', file);
+        }
+        if (t < count - 1) {
+            fputc('\n', file);
+        }
+    }
+    rewind(file);
+    return file;
+}
+
+/*
+ * Fill cells of a board at random, alternating players
+ * Param: board - the empty board to fill
+ *        fill - the chance of each cell being filled
+ *        random - the random number state
+ */
+void fill_board(Board* board, double fill, uint64_t* random) {
+    uint64_t limit = (uint64_t) (fill * 1024);
+    for (int row = 0; row < board->height; row++) {
+        for (int column = 0; column < board->width; column++) {
+            if (bench_random(random) % 1024 < limit) {
+                set_cell(board, row, column,
+                        (row + column) % 2 ? SECOND_TYPE : FIRST_TYPE);
+            }
+        }
+    }
+}
+
+/*
+ * Run a benchmark for long enough to time, doubling the operations run
+ * until it takes benchSeconds, and print the result as a JSON line
+ * Param: name - the name of the benchmark
+ *        bench - the position to run it on, or NULL
+ *        run - the benchmark
+ *        items - the items (cells, tiles) each operation handles
+ */
+void measure(char* name, Bench* bench, BenchRun run, long items) {
+    long ops = 1, allocated = 0;
+    double seconds = 0;
+    while (1) {
+        long before = allocations;
+        double start = now_seconds();
+        sink += run(bench, ops);
+        seconds = now_seconds() - start;
+        allocated = allocations - before;
+        if (seconds >= benchSeconds || ops >= (1L << 40)) {
+            break;
+        }
+        ops *= 2;
+    }
+    printf("{\"engine\":\"%s\",\"bench\":\"%s\",\"height\":%d,\"width\":%d,"
+            "\"fill\":%.2f,\"index\":%d,\"threads\":%d,\"ops\":%ld,"
+            "\"ns_per_op\":%.1f,"
+            "\"ops_per_sec\":%.1f,\"items_per_op\":%ld,"
+            "\"items_per_sec\":%.1f,\"allocs_per_op\":%.3f}\n",
+            engine_kernel(), name,
+            bench->board ? bench->board->height : 0,
+            bench->board ? bench->board->width : 0, bench->fill,
+            bench->board ? bench->board->index != NULL : 0, bench->threads,
+            ops,
+            seconds * 1e9 / ops, ops / seconds, items,
+            ops * items / seconds, (double) allocated / ops);
+    fflush(stdout);
+}
+
+/* Check random anchors and rotations for legal placements */
+long run_valid_place(Bench* bench, long ops) {
+    long found = 0;
+    for (long i = 0; i < ops; i++) {
+        Move* move = &bench->anchors[i % ANCHORS];
+        Tile* tile = &bench->tiles->allTiles[i % bench->tiles->size];
+        found += valid_place(rotate_tile(move->rotation * 90, tile),
+                bench->board, move->row, move->column);
+    }
+    return found;
+}
+
+/* Scan for the first legal move as AUTO_1 does on its first turn */
+long run_game_end1(Bench* bench, long ops) {
+    Player player, another;
+    long found = 0;
+    player.order = FIRST_PLAYER;
+    another.order = SECOND_PLAYER;
+    for (long i = 0; i < ops; i++) {
+        Tile* tile = &bench->tiles->allTiles[i % bench->tiles->size];
+        found += !game_end1(tile, bench->board, &player, &another, 1, 0);
+    }
+    return found;
+}
+
+/*
+ * Scan for the first legal move as AUTO_2 does, from the usual start
+ * Param: bench - the position to scan
+ *        ops - the scans to run
+ *        order - FIRST_PLAYER to scan forwards; SECOND_PLAYER backwards
+ * Return: the number of scans which found a move
+ */
+long run_game_end2(Bench* bench, long ops, int order) {
+    Player player;
+    long found = 0;
+    player.type = AUTO_2;
+    player.order = order;
+    player.pool = bench->pool;
+    for (long i = 0; i < ops; i++) {
+        Tile* tile = &bench->tiles->allTiles[i % bench->tiles->size];
+        set_start(bench->board, &player);
+        found += !game_end2(tile, bench->board, &player);
+    }
+    return found;
+}
+
+/* Scan as the first AUTO_2 player does */
+long run_game_end2_forward(Bench* bench, long ops) {
+    return run_game_end2(bench, ops, FIRST_PLAYER);
+}
+
+/* Scan as the second AUTO_2 player does */
+long run_game_end2_reverse(Bench* bench, long ops) {
+    return run_game_end2(bench, ops, SECOND_PLAYER);
+}
+
+/* Put legal moves on the board and take them off again */
+long run_put_tile(Bench* bench, long ops) {
+    for (long i = 0; i < ops; i++) {
+        Move* move = &bench->moves[i % bench->moveCount];
+        Tile* tile = &bench->tiles->allTiles[i % bench->moveCount %
+                bench->tiles->size];
+        uint8_t* rotation = rotate_tile(move->rotation * 90, tile);
+        put_tile(rotation, bench->board, move->row, move->column, FIRST_TYPE);
+        take_tile(rotation, bench->board, move->row, move->column);
+    }
+    return (long) bench->board->hash;
+}
+
+/* Print the board to /dev/null */
+long run_print_board(Bench* bench, long ops) {
+    for (long i = 0; i < ops; i++) {
+        print_board(bench->sink, bench->board);
+    }
+    fflush(bench->sink);
+    return ops;
+}
+
+/*
+ * Save the board again and again
+ * Param: bench - the position to save
+ *        ops - the saves to run
+ *        path - the file to save to
+ * Return: the number of saves which worked
+ */
+long save_to(Bench* bench, long ops, char* path) {
+    long saved = 0;
+    for (long i = 0; i < ops; i++) {
+        saved += save(path, bench->tiles, FIRST_PLAYER, bench->board);
+    }
+    return saved;
+}
+
+/* Save the board to the text save file */
+long run_save(Bench* bench, long ops) {
+    return save_to(bench, ops, bench->path);
+}
+
+/* Save the board to the binary save file */
+long run_save_binary(Bench* bench, long ops) {
+    return save_to(bench, ops, bench->binaryPath);
+}
+
+/*
+ * Load a save file again and again, building the board and its index
+ * Param: bench - the benchmarks
+ *        ops - the loads to run
+ *        path - the file to load
+ * Return: the number of loads which worked
+ */
+long load_from(Bench* bench, long ops, char* path) {
+    long loaded = 0;
+    for (long i = 0; i < ops; i++) {
+        loaded += load_game(&bench->game, path) == ERROR_NONE;
+        free_board(&bench->game.board);
+        bench->game.board.occupied = NULL;
+        bench->game.board.chunks = NULL;
+        bench->game.board.index = NULL;
+    }
+    return loaded;
+}
+
+/* Load the text save file */
+long run_load_game(Bench* bench, long ops) {
+    return load_from(bench, ops, bench->path);
+}
+
+/* Load the binary save file */
+long run_load_binary(Bench* bench, long ops) {
+    return load_from(bench, ops, bench->binaryPath);
+}
+
+/* Read the generated tile file */
+long run_read_file(Bench* bench, long ops) {
+    long read = 0;
+    for (long i = 0; i < ops; i++) {
+        AllTiles tiles;
+        rewind(bench->tileFile);
+        read += read_file(bench->tileFile, &tiles) == ERROR_NONE;
+        free_tiles(&tiles);
+    }
+    return read;
+}
+
+/* Load the tile library from its path */
+long run_load_tiles(Bench* bench, long ops) {
+    long read = 0;
+    for (long i = 0; i < ops; i++) {
+        AllTiles tiles;
+        read += load_tiles(bench->libraryPath, &tiles) == ERROR_NONE;
+        free_tiles(&tiles);
+    }
+    return read;
+}
+
+/*
+ * Run every benchmark on one board, with and without the legal-move index
+ * where it makes a difference
+ * Param: bench - the benchmarks, with tiles, sink, path and game set
+ *        height, width - the size of the board
+ *        fill - the fraction of cells to fill
+ *        random - the random number state
+ */
+void bench_board(Bench* bench, int height, int width, double fill,
+        uint64_t* random) {
+    Board board;
+    board.height = height;
+    board.width = width;
+    new_board(&board);
+    fill_board(&board, fill, random);
+    build_index(&board, bench->tiles);
+    bench->board = &board;
+    bench->fill = fill;
+    bench->moveCount = 0;
+    for (int i = 0; i < ANCHORS; i++) {
+        Move* move = &bench->anchors[i];
+        move->row = (int) (bench_random(random) % (height + 2 * MIDDLE)) -
+                MIDDLE;
+        move->column = (int) (bench_random(random) % (width + 2 * MIDDLE)) -
+                MIDDLE;
+        move->rotation = (int) (bench_random(random) % 4);
+        Tile* tile = &bench->tiles->allTiles[bench->moveCount %
+                bench->tiles->size];
+        if (bench->moveCount < MOVES && valid_place(rotate_tile(
+                move->rotation * 90, tile), &board, move->row, move->column)) {
+            bench->moves[bench->moveCount++] = *move;
+        }
+    }
+    long cells = (long) height * width;
+    measure("valid_place", bench, run_valid_place, 1);
+    MoveIndex* index = board.index;
+    for (int indexed = index != NULL; indexed >= 0; indexed--) {
+        board.index = indexed ? index : NULL;
+        measure("game_end1", bench, run_game_end1, cells);
+        measure("game_end2_forward", bench, run_game_end2_forward, cells);
+        measure("game_end2_reverse", bench, run_game_end2_reverse, cells);
+        for (int t = 0; cells >= SCALING_CELLS && t < SCALING_STEPS; t++) {
+            // The same scans again, to see how they scale
+            bench->pool = bench->pools[t];
+            bench->threads = 2 << t;
+            measure("game_end2_forward", bench, run_game_end2_forward,
+                    cells);
+            measure("game_end2_reverse", bench, run_game_end2_reverse,
+                    cells);
+        }
+        bench->pool = NULL;
+        bench->threads = 1;
+    }
+    board.index = index;
+    if (bench->moveCount > 0) {
+        measure("put_tile", bench, run_put_tile, 1);
+    }
+    measure("print_board", bench, run_print_board, cells);
+    measure("save", bench, run_save, cells);
+    measure("load_game", bench, run_load_game, cells);
+    measure("save_binary", bench, run_save_binary, cells);
+    measure("load_binary", bench, run_load_binary, cells);
+    free_board(&board);
+}
+
+int main(int argc, char** argv) {
+    int sizes[] = {5, 10, 50, 200, 998};
+    double fills[] = {0.0, 0.3, 0.6, 0.9};
+    if (argc > 2 || (argc == 2 && (benchSeconds = atof(argv[1])) <= 0)) {
+        fprintf(stderr, "Usage: fitz_bench [seconds]\n");
+        exit(ERROR_ARG);
+    }
+    uint64_t random = SEED;
+    AllTiles tiles;
+    FILE* tileFile = generate_tiles(NULL, BENCH_TILES, &random);
+    if (tileFile == NULL || read_file(tileFile, &tiles) != ERROR_NONE) {
+        fprintf(stderr, "Can't generate tiles\n");
+        exit(ERROR_TILE_CONTENTS);
+    }
+    fclose(tileFile);
+    char path[] = "/tmp/fitz_bench_XXXXXX";
+    char binaryPath[] = "/tmp/fitz_bench_XXXXXX.fzb";
+    char libraryPath[] = "/tmp/fitz_bench_XXXXXX";
+    int descriptor = mkstemp(path);
+    int binaryDescriptor = mkstemps(binaryPath, 4);
+    int libraryDescriptor = mkstemp(libraryPath);
+    FILE* library = libraryDescriptor < 0 ? NULL :
+            fdopen(libraryDescriptor, "w");
+    Bench* bench = (Bench*) calloc(1, sizeof(Bench));
+    bench->tiles = &tiles;
+    bench->path = path;
+    bench->binaryPath = binaryPath;
+    bench->sink = fopen("/dev/null", "w");
+    bench->libraryPath = libraryPath;
+    bench->tileFile = generate_tiles(NULL, LOAD_TILES, &random);
+    if (descriptor < 0 || binaryDescriptor < 0 || bench->sink == NULL ||
+            bench->tileFile == NULL ||
+            generate_tiles(library, LIBRARY_TILES, &random) == NULL ||
+            fclose(library) != 0) {
+        fprintf(stderr, "Can't create benchmark files\n");
+        exit(ERROR_ACCESS_SAVE);
+    }
+    close(descriptor);
+    close(binaryDescriptor);
+    init_game(&bench->game, &tiles, "1", "2");
+    bench->threads = 1;
+    for (int t = 0; t < SCALING_STEPS; t++) {
+        bench->pools[t] = new_scan_pool(2 << t);
+    }
+    measure("read_file", bench, run_read_file, LOAD_TILES);
+    measure("load_tiles", bench, run_load_tiles, LIBRARY_TILES);
+    for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int f = 0; f < sizeof(fills) / sizeof(fills[0]); f++) {
+            bench_board(bench, sizes[s], sizes[s], fills[f], &random);
+        }
+    }
+    free_game(&bench->game);
+    for (int t = 0; t < SCALING_STEPS; t++) {
+        free_scan_pool(bench->pools[t]);
+    }
+    fclose(bench->sink);
+    fclose(bench->tileFile);
+    unlink(path);
+    unlink(binaryPath);
+    unlink(libraryPath);
+    free(bench);
+    free_tiles(&tiles);
+    return sink == -1; // Never, but sink is used
+}
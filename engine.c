@@ -0,0 +1,4444 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "fitz.h"
+
+#define MAX 70 // Initial size of a dynamic char array
+#define MARGIN (2 * MIDDLE) // Off-board cells kept around the board grid
+#define WORD_BITS 64 // Cells packed into each word of a board row
+#define WINDOW_MASK ((1 << TILE_SIZE) - 1) // One tile row of board cells
+#define REACH (2 * MIDDLE) // Anchors this far from a placement are affected
+#define INDEX_LIMIT (64 << 20) // Largest legal-move index to build, in bytes
+#define DENSE_LIMIT (64 << 20) // Largest board bit planes held whole, in
+                               // bytes; bigger boards are sparse
+#define CHUNK_ROWS 64 // Padded rows in each chunk of a sparse board
+#define SPAN_WORDS 64 // Words of a sparse row legal_span() works on at a time
+#define PLANE_OCCUPIED 0 // The bit plane of placed tiles and the margin
+#define PLANE_SECOND 1 // The bit plane of cells placed by the second player
+#define SCAN_WORDS 1024 // Scratch words scan_board() keeps on the stack
+#define PRINT_BUFFER 65536 // Bytes of board text written at a time
+#define SAVE_SUFFIX ".fzb" // Games saved to paths ending in this are binary
+#define SAVE_MAGIC 0x315641535A544946ULL // "FITZSAV1" read little-endian
+#define SPARSE_MAGIC 0x315250535A544946ULL // "FITZSPR1" read little-endian
+#define JOURNAL_MAGIC 0x314C4E4A5A544946ULL // "FITZJNL1" read little-endian
+#define RECORD_MAGIC 0x314345525A544946ULL // "FITZREC1" read little-endian
+#define HISTORY_START 64 // Moves a game's history has room for at first
+#define SEARCH_DEPTH 4 // Deepest search of the search player, in moves
+#define SEARCH_NODES 20000 // Most positions searched per move
+#define SEARCH_MAX_DEPTH 15 // Deepest a timed search goes; the table keeps
+                            // depths in 4 bits
+#define SEARCH_ROOT_MOVES 256 // Most root moves a timed search tries
+#define TABLE_BITS 20 // The transposition table has 2^TABLE_BITS entries
+#define WIN 30000 // Score of a won position, less the moves taken to win
+#define LOWER 1 // Transposition table bounds: score is at least this
+#define UPPER 2 // Score is at most this
+#define EXACT 3 // Score is exact
+#define ENDGAME_FREE 256 // Most free cells the endgame solver takes on
+#define ENDGAME_SHAPES 64 // Most distinct tiles the endgame solver takes on
+#define ENDGAME_NODES 100000 // Most positions an endgame player solves
+#define MEMO_BITS 20 // The endgame memo has 2^MEMO_BITS entries
+#define MCTS_PLAYOUTS 2000 // Playouts per move of the MCTS player by default
+#define MCTS_WIDTH 16 // Most candidate moves tried at one tree node
+#define MCTS_EXPLORE 1.4 // UCT exploration weight
+#define MCTS_THREADS 64 // Most threads running playouts
+#define SCAN_THREADS 64 // Most threads scanning a board
+#define SCAN_CHUNK 16 // Anchor rows handed to a scan thread at a time
+#define PARALLEL_CELLS (1 << 16) // Boards this big are scanned in parallel
+#ifdef FITZ_STATS
+#define COUNT_STAT(stat, n) (threadStats[stat] += (n))
+#else
+#define COUNT_STAT(stat, n) ((void) 0) // Not even n is worked out
+#endif
+
+/*
+ * One transposition table entry. check is the position key xor data, so an
+ * entry torn by two threads writing at once never matches a lookup and the
+ * table needs no locks.
+ */
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+} TableEntry;
+
+/*
+ * The start of a binary save file. Every field is a little-endian 64-bit
+ * word. The cells follow: for each row, (width + 63) / 64 words of occupied
+ * cells and as many of second player cells, column j of a word block at bit
+ * j % 64 of word j / 64, like a Board row without its margin.
+ * A sparse board is saved with SPARSE_MAGIC instead, and its cells follow as
+ * SparseCells records: one for each word block with any occupied cells, in
+ * order of row and then word.
+ */
+typedef struct {
+    uint64_t magic; // SAVE_MAGIC
+    uint64_t tile; // Next tile to play (starting from 0)
+    uint64_t player; // The next player to have their turn (0 or 1)
+    uint64_t height;
+    uint64_t width;
+    uint64_t checksum; // tile_checksum() of the tiles saved with
+} SaveHeader;
+
+/* A word block of a sparse binary save, little-endian like its header */
+typedef struct {
+    uint64_t row;
+    uint64_t word; // The word block of the row, as in a save
+    uint64_t occupied; // Occupied cells of the block
+    uint64_t second; // Second player cells of the block
+} SparseCells;
+
+/*
+ * The start of a journal, little-endian like a binary save. The key is
+ * worked out from the snapshot's board hash, next tile and next player, so
+ * a journal left over from before a snapshot was replaced is ignored. The
+ * turn and the players' last moves, which a save doesn't hold, let the
+ * automatic players carry on as if the game had never stopped.
+ */
+typedef struct {
+    uint64_t magic; // JOURNAL_MAGIC
+    uint64_t key; // The snapshot the records follow
+    uint64_t turn; // The turn at the snapshot
+    uint64_t starts[2]; // Each player's rowStart, and colStart << 32
+} JournalHeader;
+
+/*
+ * The start of a game record, little-endian like a binary save. The moves
+ * follow, packed record_bits() bits each into little-endian words from the
+ * lowest bit up, so that move n starts at bit n * bits. The last word is
+ * padded with zero bits, and the next record of the file follows.
+ */
+typedef struct {
+    uint64_t magic; // RECORD_MAGIC
+    uint64_t checksum; // tile_checksum() of the tiles played with
+    uint64_t height;
+    uint64_t width;
+    uint64_t start; // The first tile played, and the first player << 32
+    uint64_t moves; // The number of moves
+} RecordHeader;
+
+/*
+ * One move of a journal: the move, the tile played and a check word, so a
+ * record torn by a crash is recognised and dropped
+ */
+typedef struct {
+    uint64_t place; // Row in the low 32 bits, column in the high 32 bits
+    uint64_t tile; // Tile index in the low 32 bits, degrees / 90 above
+    uint64_t check; // record_check() of the two
+} JournalRecord;
+
+/* Search state of a search player */
+struct Search {
+    TableEntry* table; // 2^TABLE_BITS entries
+    Board* board; // The board searched, changed and restored while searching
+    AllTiles* tiles;
+    int current; // Tile to place next
+    int side; // Player to place it: FIRST_PLAYER or SECOND_PLAYER
+    long nodes; // Positions visited this move
+    long limit; // Positions to visit before giving up
+    double deadline; // When to give up, from now_seconds(), or 0 if never
+    int aborted; // Gave up before finishing the current depth
+    Move* roots; // The root moves to try, if not every legal move
+    int rootCount; // The number of roots; 0 to try every legal move
+};
+
+/* A placement the endgame solver can make */
+typedef struct {
+    uint64_t cells; // The cells it covers, one bit per solver cell
+    int shape; // The tile it places
+    int region; // The region of the cells
+    Move move;
+} Placement;
+
+/*
+ * A region of the free cells. No placement covers cells of two regions, so
+ * tiles put in one never change what fits in another. The cells of a region
+ * are numbered on from its first, row by row.
+ */
+typedef struct {
+    int first; // Its first cell
+    int size; // Its number of cells
+    int twin; // The first region of the same shape, maybe itself
+} Region;
+
+/* A solved endgame position */
+typedef struct {
+    uint64_t free; // The cells still free
+    int current; // The tile to place next, plus one; 0 for an empty entry
+    int won; // 1 if the player to move wins
+} MemoEntry;
+
+/*
+ * The endgame solver. The free cells some tile can still go in are
+ * numbered region by region, so a position is the bitmask of those still
+ * free and the tile to place next.
+ */
+typedef struct {
+    AllTiles* tiles;
+    Placement* placements; // Grouped by shape, then by region
+    int* first; // first[shape]: its first placement; first[shapes] is the end
+    int* solid; // solid[t]: empty tiles from tile t to the next non-empty one
+    Region regions[WORD_BITS];
+    int regionCount;
+    MemoEntry* memo; // 2^MEMO_BITS entries
+    long nodes; // Positions visited
+    long limit; // Positions to visit before giving up
+    int aborted; // Gave up after limit positions
+} Endgame;
+
+/* A node of a Monte Carlo search tree: the position after its move */
+typedef struct {
+    Move move; // The move leading here from the parent
+    int side; // The player who made the move
+    int parent; // Parent node, or -1 for the root
+    int first; // First child node, or -1
+    int next; // Next sibling node, or -1
+    int untried; // Candidate moves not expanded yet, at moves[0, untried)
+    Move moves[MCTS_WIDTH];
+    long visits;
+    double wins; // Playouts won by side
+} MctsNode;
+
+/* One move of Monte Carlo tree search, shared read-only by the threads */
+typedef struct {
+    Board* board; // The position to move from
+    AllTiles* tiles;
+    int current; // Tile to place next
+    int side; // Player to place it
+    int candidates; // Number of moves to choose from
+    Move moves[MCTS_WIDTH]; // The moves to choose from
+    long budget; // Playouts per thread, or milliseconds
+    int timed; // 1 if the budget is in milliseconds
+    double start; // When the search started, in seconds
+} Mcts;
+
+/* One thread of a Monte Carlo tree search, with its own tree and board */
+typedef struct {
+    Mcts* mcts;
+    pthread_t thread;
+    Board board; // A copy of the position, played out from and reset
+    MctsNode* nodes; // The tree; node 0 is the root
+    int count; // Nodes in the tree
+    int capacity; // Nodes allocated
+    uint64_t random; // Random number state
+    long playouts; // Playouts run
+} MctsWorker;
+
+/*
+ * A scan for the first anchor where one of some rotations fits (see
+ * scan_board()), shared read-only by the threads running it
+ */
+typedef struct {
+    uint8_t** rotations; // The rotations to try at each anchor, in order
+    uint8_t** bounds; // The bounds of each rotation's '!' cells
+    uint64_t** maps; // The indexed legal anchors of each, or NULL
+    int count; // The number of rotations
+    Board* board;
+    int rows; // Padded anchor rows; the scan takes rows + 1 steps
+    int lastBit; // The last padded anchor column
+    int startRow, startBit; // The padded start anchor
+    int reverse; // 1 to scan right to left, bottom to top
+    int indexed; // 1 if every rotation is in the legal-move index
+    int firstRow[4], lastRow[4]; // Padded anchor rows keeping '!' on board
+    int firstBit[4], lastBits[4]; // Padded anchor columns likewise
+    int cells[4][TILE_SIZE]; // '!' cells in each row of each rotation
+} Scan;
+
+/* The first fit one scan thread found */
+typedef struct {
+    int chunk; // The chunk it is in, or the number of chunks if none
+    int found; // The rotation that fits
+    int row, column; // The anchor
+} ScanResult;
+
+/* One thread of a scan pool */
+typedef struct {
+    pthread_t thread;
+    ScanPool* pool;
+    int id; // Index of its result and scratch space in the pool
+} ScanWorker;
+
+/*
+ * Threads scanning the rows of a huge board in chunks of SCAN_CHUNK steps.
+ * Chunks are handed out in scan order and a chunk is given up once an
+ * earlier one has a fit, so the fit found is the one a serial scan finds.
+ */
+struct ScanPool {
+    int threads; // Worker threads, besides the thread starting scans
+    ScanWorker workers[SCAN_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t wake; // A scan was started or the pool is closing
+    pthread_cond_t done; // A worker finished its part of a scan
+    long round; // Scans started so far
+    int busy; // Workers still on the current scan
+    int closing; // 1 when the workers are to exit
+    Scan* scan; // The current scan
+    int first; // The first step of the scan left to the pool
+    int chunks; // Chunks from the first step on
+    int next; // The next chunk to hand out
+    int best; // The earliest chunk with a fit so far, or chunks
+    ScanResult results[SCAN_THREADS + 1]; // Per thread, the starter last
+    uint64_t* scratch[SCAN_THREADS + 1]; // Per thread, as in scan_words()
+    size_t scratchWords; // Words of each scratch space
+};
+
+#ifdef FITZ_STATS
+// Hot-path counts of this thread not yet gathered, and those gathered from
+// every thread since take_stats() was last called
+__thread long threadStats[STAT_COUNT];
+long gatheredStats[STAT_COUNT];
+#endif
+
+#if TILE_SIZE == 5
+/*
+ * A tile row spread into the last column of a rotated tile: bit j of the row
+ * becomes bit TILE_SIZE - 1 of row j, with rows TILE_SIZE bits apart
+ */
+const uint32_t spreadRow[1 << TILE_SIZE] = {
+    0x0000000, 0x0000010, 0x0000200, 0x0000210, 0x0004000, 0x0004010,
+    0x0004200, 0x0004210, 0x0080000, 0x0080010, 0x0080200, 0x0080210,
+    0x0084000, 0x0084010, 0x0084200, 0x0084210, 0x1000000, 0x1000010,
+    0x1000200, 0x1000210, 0x1004000, 0x1004010, 0x1004200, 0x1004210,
+    0x1080000, 0x1080010, 0x1080200, 0x1080210, 0x1084000, 0x1084010,
+    0x1084200, 0x1084210
+};
+
+/*
+ * Rotate a tile clockwise in 90 degrees. A row bitmask becomes one column of
+ * the result, so each row is spread by a table into a word holding all five
+ * result rows, TILE_SIZE bits apart: bit j of a row lands in result row j.
+ * Param: original - the non-rotated tile
+ *        result - where to store the rotated tile
+ */
+void rotate_once(uint8_t* original, uint8_t* result) {
+    uint32_t rows = 0;
+    for (int row = 0; row < TILE_SIZE; row++) {
+        // Row i becomes column TILE_SIZE - 1 - i
+        rows |= spreadRow[original[row]] >> row;
+    }
+    for (int row = 0; row < TILE_SIZE; row++) {
+        result[row] = (uint8_t) (rows >> (row * TILE_SIZE) & WINDOW_MASK);
+    }
+}
+#else
+/*
+ * Rotate a tile clockwise in 90 degrees a cell at a time. Other sizes than
+ * 5*5 don't fit the table's word, and are only rotated when read.
+ * Param: original - the non-rotated tile
+ *        result - where to store the rotated tile
+ */
+void rotate_once(uint8_t* original, uint8_t* result) {
+    memset(result, 0, TILE_SIZE);
+    for (int row = 0; row < TILE_SIZE; row++) {
+        for (int column = 0; column < TILE_SIZE; column++) {
+            // Row i becomes column TILE_SIZE - 1 - i
+            result[column] |= (uint8_t) ((original[row] >> column & 1) <<
+                    (TILE_SIZE - 1 - row));
+        }
+    }
+}
+#endif
+
+/*
+ * Rotate the tile in all three degrees and save the rotations
+ * Param: tile - the tile to rotate
+ */
+void set_rotate(Tile* tile) {
+    for (int i = 1; i < 4; i++) {
+        rotate_once(tile->rotations[i - 1], tile->rotations[i]);
+    }
+}
+
+/*
+ * Check whether a tile rotation has no '!' at all
+ * Param: tile - the rotation to check
+ * Return: 1 if the rotation is empty; 0 otherwise
+ */
+int empty_tile(uint8_t* tile) {
+    for (int row = 0; row < TILE_SIZE; row++) {
+        if (tile[row]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Scramble a number into a well-mixed 64-bit hash (splitmix64)
+ * Param: value - the number to scramble
+ * Return: the hash
+ */
+uint64_t mix_hash(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+/*
+ * Work out a checksum of a tile set, so that binary saves can tell whether
+ * they are loaded with the tiles they were saved with
+ * Param: tiles - the tiles read
+ * Return: the checksum
+ */
+uint64_t tile_checksum(AllTiles* tiles) {
+    uint64_t checksum = mix_hash((uint64_t) tiles->size);
+    for (int t = 0; t < tiles->size; t++) {
+        uint64_t rows = 0;
+        for (int row = 0; row < TILE_SIZE; row++) {
+            rows = rows << TILE_SIZE | tiles->allTiles[t].rotations[0][row];
+        }
+        checksum = mix_hash(checksum ^ rows);
+    }
+    return checksum;
+}
+
+/*
+ * Work out which rotations of a tile repeat an earlier one and where the '!'
+ * cells of each rotation lie
+ * Param: tile - the tile, with its rotations set
+ */
+void set_bounds(Tile* tile) {
+    for (int r = 0; r < 4; r++) {
+        uint8_t* rotation = tile->rotations[r];
+        uint8_t* bounds = tile->bounds[r];
+        tile->same[r] = r;
+        for (int earlier = r - 1; earlier >= 0; earlier--) {
+            if (!memcmp(tile->rotations[earlier], rotation, TILE_SIZE)) {
+                tile->same[r] = earlier;
+            }
+        }
+        uint8_t columns = 0;
+        bounds[0] = TILE_SIZE, bounds[2] = 0;
+        for (int row = 0; row < TILE_SIZE; row++) {
+            if (rotation[row]) {
+                bounds[0] = bounds[0] < row ? bounds[0] : row;
+                bounds[2] = row;
+                columns |= rotation[row];
+            }
+        }
+        bounds[1] = columns ? __builtin_ctz(columns) : TILE_SIZE;
+        bounds[3] = columns ? 31 - __builtin_clz(columns) : 0;
+    }
+}
+
+/*
+ * Number the tiles by shape, identical tiles sharing a number. A hash table
+ * of the first tile of each shape makes this one pass over the tiles.
+ * Param: tiles - the tiles, with their rotations set
+ */
+void set_shapes(AllTiles* tiles) {
+    size_t buckets = 2;
+    while (buckets < 2 * (size_t) tiles->size) {
+        buckets *= 2;
+    }
+    int* table = (int*) malloc(sizeof(int) * buckets); // Tile, or -1
+    memset(table, -1, sizeof(int) * buckets);
+    tiles->shapes = 0;
+    for (int t = 0; t < tiles->size; t++) {
+        Tile* tile = &tiles->allTiles[t];
+        uint64_t rows = 0;
+        for (int row = 0; row < TILE_SIZE; row++) {
+            rows = rows << TILE_SIZE | tile->rotations[0][row];
+        }
+        size_t bucket = mix_hash(rows) & (buckets - 1);
+        while (table[bucket] >= 0 && memcmp(
+                tiles->allTiles[table[bucket]].rotations[0],
+                tile->rotations[0], TILE_SIZE)) {
+            bucket = (bucket + 1) & (buckets - 1);
+        }
+        if (table[bucket] < 0) {
+            table[bucket] = t;
+            tile->shape = tiles->shapes++;
+        } else {
+            tile->shape = tiles->allTiles[table[bucket]].shape;
+        }
+    }
+    free(table);
+}
+
+/*
+ * Called by parse_tiles(). Free the tiles read so far.
+ * Param: tiles - the collection being read
+ * Return: ERROR_TILE_CONTENTS
+ */
+int invalid_file(AllTiles* tiles) {
+    free(tiles->allTiles);
+    tiles->allTiles = NULL;
+    tiles->size = 0;
+    return ERROR_TILE_CONTENTS;
+}
+
+/*
+ * Parse the text of a tile file. Every tile is TILE_SIZE lines of TILE_SIZE
+ * characters, and tiles are separated by blank lines, so the number of tiles
+ * follows from the length and the whole array is allocated at once.
+ * Param: text - the text of the tile file
+ *        length - the number of characters in text
+ *        tiles - the collection to store all tiles
+ * Return: ERROR_NONE, or ERROR_TILE_CONTENTS if the text is incorrect.
+ *         Nothing is left allocated then.
+ */
+int parse_tiles(const char* text, size_t length, AllTiles* tiles) {
+    size_t tileLength = TILE_SIZE * (TILE_SIZE + 1) + 1; // With the blank line
+    tiles->allTiles = NULL;
+    tiles->size = 0;
+    if ((length + 1) % tileLength != 0 ||
+            (length + 1) / tileLength > INT_MAX) {
+        return invalid_file(tiles);
+    }
+    int count = (int) ((length + 1) / tileLength);
+    tiles->allTiles = (Tile*) malloc(sizeof(Tile) * count);
+    for (int t = 0; t < count; t++) {
+        const char* next = text + t * tileLength;
+        uint8_t* rows = tiles->allTiles[t].rotations[0];
+        int valid = t == count - 1 || next[tileLength - 1] == '\n';
+        for (int row = 0; row < TILE_SIZE; row++) {
+            uint8_t bits = 0;
+            for (int column = 0; column < TILE_SIZE; column++) {
+                char cell = *next++;
+                bits |= (cell == TILE_EXIST) << column;
+                valid &= cell == TILE_EXIST || cell == TILE_EMPTY;
+            }
+            valid &= *next++ == '\n';
+            rows[row] = bits;
+        }
+        if (!valid) {
+            return invalid_file(tiles);
+        }
+        set_rotate(&tiles->allTiles[t]);
+        set_bounds(&tiles->allTiles[t]);
+    }
+    tiles->size = count;
+    tiles->checksum = tile_checksum(tiles);
+    set_shapes(tiles);
+    return ERROR_NONE;
+}
+
+/**
+ * Read the tile file. The rest of the file is read into memory in one go and
+ * parsed by parse_tiles().
+ * Param: file - the tile file
+ *        tiles - the collection to store all tiles
+ * Return: ERROR_NONE, or ERROR_TILE_CONTENTS if the tile file is incorrect.
+ *         Nothing is left allocated then.
+ */
+int read_file(FILE* file, AllTiles* tiles) {
+    size_t length = 0, capacity = 0;
+    long start = ftell(file);
+    if (start >= 0 && fseek(file, 0, SEEK_END) == 0) {
+        long end = ftell(file);
+        if (fseek(file, start, SEEK_SET) == 0 && end > start) {
+            capacity = (size_t) (end - start);
+        }
+    }
+    // One byte more than the known size, so reaching the end takes one read
+    capacity = capacity ? capacity + 1 : MAX;
+    char* text = (char*) malloc(capacity);
+    while (1) {
+        length += fread(text + length, 1, capacity - length, file);
+        if (length < capacity) {
+            break;
+        }
+        // Only when the file size wasn't known up front (e.g. a pipe)
+        capacity *= 2;
+        text = (char*) realloc(text, capacity);
+    }
+    int error = parse_tiles(text, length, tiles);
+    free(text);
+    return error;
+}
+
+/*
+ * Read the tile file at a path, mapping it into memory when it is a regular
+ * file
+ * Param: path - the path of the tile file
+ *        tiles - the collection to store all tiles, starting at the first
+ * Return: ERROR_NONE, ERROR_ACCESS_TILE if the file can't be read or
+ *         ERROR_TILE_CONTENTS if it is incorrect
+ */
+int load_tiles(char* path, AllTiles* tiles) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return ERROR_ACCESS_TILE;
+    }
+    tiles->current = 0;
+    struct stat status;
+    int error;
+    void* text = MAP_FAILED;
+    if (fstat(fileno(file), &status) == 0 && S_ISREG(status.st_mode) &&
+            status.st_size > 0) {
+        text = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE,
+                fileno(file), 0);
+    }
+    if (text != MAP_FAILED) {
+        madvise(text, status.st_size, MADV_SEQUENTIAL);
+        error = parse_tiles((const char*) text, status.st_size, tiles);
+        munmap(text, status.st_size);
+    } else {
+        error = read_file(file, tiles);
+    }
+    fclose(file);
+    return error;
+}
+
+/*
+ * Print one row of a tile rotation
+ * Param: out - the stream to print to
+ *        bits - the row bitmask to print as '!' and ','
+ */
+void print_tile_row(FILE* out, uint8_t bits) {
+    for (int column = 0; column < TILE_SIZE; column++) {
+        fprintf(out, "%c", (bits & (1 << column)) ? TILE_EXIST : TILE_EMPTY);
+    }
+}
+
+/*
+ * Print a tile.
+ * Param: out - the stream to print to
+ *        tile - the tile to print
+ *        all - if all is 1, print all rotations. Otherwise just the original
+ */
+void print_tile(FILE* out, Tile* tile, int all) {
+    for (int row = 0; row < TILE_SIZE; row++) {
+        print_tile_row(out, tile->rotations[0][row]);
+        for (int i = 1; all && i < 4; i++) {
+            fprintf(out, " ");
+            print_tile_row(out, tile->rotations[i][row]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+/*
+ * Print every tile with its rotations
+ * Param: out - the stream to print to
+ *        tiles - all tiles to print
+ */
+void print_all_tiles(FILE* out, AllTiles* tiles) {
+    for (int i = 0; i < tiles->size; i++) {
+        print_tile(out, &(tiles->allTiles[i]), 1);
+        if (i < tiles->size - 1) {
+            fprintf(out, "\n");
+        }
+    }
+}
+
+/*
+ * Get a padded row of a board bit plane, for a board which isn't sparse
+ * Param: board - the board the plane belongs to
+ *        plane - board->occupied or board->second
+ *        row - the board row, from -MARGIN to height + MARGIN - 1
+ * Return: the first word of the row
+ */
+uint64_t* board_row(Board* board, uint64_t* plane, int row) {
+    return plane + (size_t) (row + MARGIN) * board->stride;
+}
+
+/*
+ * Read TILE_SIZE consecutive cells of a padded row
+ * Param: line - the padded row
+ *        bit - the first cell to read, as a bit index into the row
+ * Return: the cells as a bitmask in the same layout as a tile row
+ */
+uint64_t get_window(uint64_t* line, int bit) {
+    int word = bit / WORD_BITS, shift = bit % WORD_BITS;
+    uint64_t bits = line[word] >> shift;
+    if (shift > WORD_BITS - TILE_SIZE) {
+        bits |= line[word + 1] << (WORD_BITS - shift);
+    }
+    return bits & WINDOW_MASK;
+}
+
+/*
+ * Get the margin cells of one word of a padded row
+ * Param: board - the board
+ *        row - the board row, from -MARGIN to height + MARGIN - 1
+ *        word - the word of the row
+ * Return: the bits of the word which are off the board
+ */
+uint64_t margin_word(Board* board, int row, int word) {
+    int first = word * WORD_BITS;
+    int end = board->width + MARGIN - first;
+    if (row < 0 || row >= board->height || end <= 0) {
+        return ~(uint64_t) 0;
+    }
+    uint64_t margin = end < WORD_BITS ? ~(uint64_t) 0 << end : 0;
+    if (first < MARGIN) {
+        margin |= ((uint64_t) 1 << (MARGIN - first)) - 1;
+    }
+    return margin;
+}
+
+/*
+ * Find where a sparse board keeps the chunk holding a word of a padded row
+ * Param: board - the sparse board
+ *        row - the board row, from -MARGIN to height + MARGIN - 1
+ *        word - the word of the row
+ * Return: the chunk's place in board->chunks
+ */
+uint64_t** chunk_slot(Board* board, int row, int word) {
+    return board->chunks + (size_t) ((row + MARGIN) / CHUNK_ROWS) *
+            board->stride + word;
+}
+
+/*
+ * Read one word of a padded row of either bit plane
+ * Param: board - the board
+ *        plane - PLANE_OCCUPIED or PLANE_SECOND
+ *        row - the board row, from -MARGIN to height + MARGIN - 1
+ *        word - the word of the row
+ * Return: the word
+ */
+uint64_t row_word(Board* board, int plane, int row, int word) {
+    if (board->chunks == NULL) {
+        return board_row(board, plane == PLANE_SECOND ? board->second :
+                board->occupied, row)[word];
+    }
+    uint64_t* chunk = *chunk_slot(board, row, word);
+    uint64_t bits = chunk == NULL ? 0 :
+            chunk[plane * CHUNK_ROWS + (row + MARGIN) % CHUNK_ROWS];
+    return plane == PLANE_OCCUPIED ? bits | margin_word(board, row, word) :
+            bits;
+}
+
+/*
+ * Get one word of a padded row to change it. On a sparse board the chunk
+ * holding it is allocated the first time.
+ * Param: board - the board
+ *        plane - PLANE_OCCUPIED or PLANE_SECOND
+ *        row - the board row; the word must hold cells on the board
+ *        word - the word of the row
+ * Return: the word
+ */
+uint64_t* write_word(Board* board, int plane, int row, int word) {
+    if (board->chunks == NULL) {
+        return board_row(board, plane == PLANE_SECOND ? board->second :
+                board->occupied, row) + word;
+    }
+    uint64_t** slot = chunk_slot(board, row, word);
+    if (*slot == NULL) {
+        *slot = (uint64_t*) calloc(2 * CHUNK_ROWS, sizeof(uint64_t));
+    }
+    return *slot + plane * CHUNK_ROWS + (row + MARGIN) % CHUNK_ROWS;
+}
+
+/*
+ * Read 64 consecutive cells of a padded row
+ * Param: board - the board
+ *        plane - PLANE_OCCUPIED or PLANE_SECOND
+ *        row - the board row, from -MARGIN to height + MARGIN - 1
+ *        bit - the first cell to read, as a bit index into the row; the
+ *              cells must not run past the row
+ * Return: the cells, the first at bit 0
+ */
+uint64_t read_cells(Board* board, int plane, int row, int bit) {
+    int word = bit / WORD_BITS, shift = bit % WORD_BITS;
+    uint64_t bits = row_word(board, plane, row, word) >> shift;
+    if (shift) {
+        bits |= row_word(board, plane, row, word + 1) << (WORD_BITS - shift);
+    }
+    return bits;
+}
+
+/*
+ * Set or clear up to 64 consecutive cells of a padded row. Words none of
+ * the cells fall in are left alone, so a sparse board doesn't allocate them.
+ * Param: board - the board
+ *        plane - PLANE_OCCUPIED or PLANE_SECOND
+ *        row - the board row; the cells must be on the board
+ *        bit - the first cell, as a bit index into the row
+ *        bits - the cells to change, the first at bit 0
+ *        set - 1 to set the cells; 0 to clear them
+ */
+void change_cells(Board* board, int plane, int row, int bit, uint64_t bits,
+        int set) {
+    int word = bit / WORD_BITS, shift = bit % WORD_BITS;
+    uint64_t parts[2] = {bits << shift,
+            shift ? bits >> (WORD_BITS - shift) : 0};
+    for (int k = 0; k < 2; k++) {
+        if (parts[k]) {
+            uint64_t* line = write_word(board, plane, row, word + k);
+            *line = set ? *line | parts[k] : *line & ~parts[k];
+        }
+    }
+}
+
+/*
+ * Get the Zobrist key of a cell. Keys are worked out from the cell rather
+ * than kept in a table, which would be as big as the board.
+ * Param: row, column - the cell on the board
+ * Return: the key to xor into the board hash when the cell is occupied
+ */
+uint64_t cell_key(int row, int column) {
+    return mix_hash(((uint64_t) (uint32_t) row << 32) | (uint32_t) column);
+}
+
+/*
+ * Xor the Zobrist keys of the cells under a tile into the board hash
+ * Param: tile - the tile covering the cells
+ *        board - the board whose hash to change
+ *        row, column - where the tile is on the board
+ */
+void hash_tile(uint8_t* tile, Board* board, int row, int column) {
+    for (int i = 0; i < TILE_SIZE; i++) {
+        for (int j = 0; j < TILE_SIZE; j++) {
+            if (tile[i] & (1 << j)) {
+                board->hash ^= cell_key(row + i - MIDDLE,
+                        column + j - MIDDLE);
+            }
+        }
+    }
+}
+
+/*
+ * Get the contents of one cell of the board
+ * Param: board - the board to look at
+ *        row, column - the cell on the board
+ * Return: BOARD_EMPTY, FIRST_TYPE or SECOND_TYPE
+ */
+char get_cell(Board* board, int row, int column) {
+    if (!(read_cells(board, PLANE_OCCUPIED, row, column + MARGIN) & 1)) {
+        return BOARD_EMPTY;
+    }
+    return (read_cells(board, PLANE_SECOND, row, column + MARGIN) & 1) ?
+            SECOND_TYPE : FIRST_TYPE;
+}
+
+/*
+ * Set one empty cell of the board
+ * Param: board - the board to change
+ *        row, column - the cell on the board
+ *        type - BOARD_EMPTY, FIRST_TYPE or SECOND_TYPE
+ */
+void set_cell(Board* board, int row, int column, char type) {
+    if (type != BOARD_EMPTY) {
+        change_cells(board, PLANE_OCCUPIED, row, column + MARGIN, 1, 1);
+        board->hash ^= cell_key(row, column);
+    }
+    if (type == SECOND_TYPE) {
+        change_cells(board, PLANE_SECOND, row, column + MARGIN, 1, 1);
+    }
+}
+
+/*
+ * Count the chunks of a sparse board's directory
+ * Param: board - the sparse board
+ * Return: the number of chunks, allocated or not
+ */
+size_t chunk_count(Board* board) {
+    return (size_t) (board->height + 2 * MARGIN + CHUNK_ROWS - 1) /
+            CHUNK_ROWS * board->stride;
+}
+
+/*
+ * Build a new empty board. Every cell of the margin is occupied. A board
+ * whose bit planes would take more than DENSE_LIMIT bytes is sparse, and
+ * starts with no chunks at all.
+ * Param: board - the board to build the empty grid in
+ */
+void new_board(Board* board) {
+    int rows = board->height + 2 * MARGIN;
+    int bits = board->width + 2 * MARGIN;
+    board->stride = (bits + WORD_BITS - 1) / WORD_BITS + 1;
+    board->index = NULL;
+    board->hash = 0;
+    if ((size_t) rows * board->stride * 2 * sizeof(uint64_t) > DENSE_LIMIT) {
+        board->occupied = board->second = NULL;
+        board->chunks = (uint64_t**) calloc(chunk_count(board),
+                sizeof(uint64_t*));
+        return;
+    }
+    board->chunks = NULL;
+    board->occupied = (uint64_t*) calloc((size_t) rows * board->stride * 2,
+            sizeof(uint64_t));
+    board->second = board->occupied + (size_t) rows * board->stride;
+    for (int row = 0; row < rows; row++) {
+        uint64_t* line = board->occupied + (size_t) row * board->stride;
+        int onBoard = row >= MARGIN && row < board->height + MARGIN;
+        for (int bit = 0; bit < board->stride * WORD_BITS; bit++) {
+            if (!onBoard || bit < MARGIN || bit >= board->width + MARGIN) {
+                line[bit / WORD_BITS] |= (uint64_t) 1 << (bit % WORD_BITS);
+            }
+        }
+    }
+}
+
+/*
+ * Free the bit planes in Board
+ * Param: board - whose planes to be freed
+ */
+void free_board(Board* board) {
+    if (board->chunks != NULL) {
+        size_t count = chunk_count(board);
+        for (size_t n = 0; n < count; n++) {
+            free(board->chunks[n]);
+        }
+        free(board->chunks);
+    }
+    free(board->occupied);
+    free(board->index);
+}
+
+/*
+ * Print the board. The text is built straight from the bit planes and
+ * written PRINT_BUFFER bytes at a time, so a 998x998 board takes a few
+ * dozen writes rather than a million.
+ * Param: out - the stream to print to
+ *        board - the board to print its grid
+ */
+void print_board(FILE* out, Board* board) {
+    // Indexed by the occupied bit plus twice the second bit
+    char cells[4] = {BOARD_EMPTY, FIRST_TYPE, BOARD_EMPTY, SECOND_TYPE};
+    char text[PRINT_BUFFER];
+    int n = 0;
+    for (int i = 0; i < board->height; i++) {
+        uint64_t occupied = 0, second = 0;
+        for (int bit = MARGIN; bit < board->width + MARGIN; bit++) {
+            if (n == PRINT_BUFFER) {
+                fwrite(text, 1, n, out);
+                n = 0;
+            }
+            int shift = bit % WORD_BITS;
+            if (bit == MARGIN || shift == 0) {
+                occupied = row_word(board, PLANE_OCCUPIED, i, bit / WORD_BITS);
+                second = row_word(board, PLANE_SECOND, i, bit / WORD_BITS);
+            }
+            text[n++] = cells[(occupied >> shift & 1) |
+                    (second >> shift & 1) << 1];
+        }
+        if (n == PRINT_BUFFER) {
+            fwrite(text, 1, n, out);
+            n = 0;
+        }
+        text[n++] = '\n';
+    }
+    fwrite(text, 1, n, out);
+}
+
+/*
+ * Print the cells a placement fills, one "row column type" line each, in
+ * one write
+ * Param: out - the stream to print to
+ *        tile - the rotation placed
+ *        row, column - where the middle of the tile went
+ *        type - FIRST_TYPE or SECOND_TYPE
+ */
+void print_cells(FILE* out, uint8_t* tile, int row, int column, char type) {
+    char text[TILE_SIZE * TILE_SIZE * 16];
+    int n = 0;
+    for (int i = 0; i < TILE_SIZE; i++) {
+        for (int j = 0; j < TILE_SIZE; j++) {
+            if (tile[i] & (1 << j)) {
+                n += sprintf(text + n, "%d %d %c\n", row + i - MIDDLE,
+                        column + j - MIDDLE, type);
+            }
+        }
+    }
+    fwrite(text, 1, n, out);
+}
+
+/*
+ * Name the kernel block_anchors() was built with, to tell results apart
+ * Return: "avx2", "sse2" or "scalar"
+ */
+char* engine_kernel(void) {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+/*
+ * Add this thread's hot-path counts to those gathered, before the thread
+ * finishes its part of a turn
+ */
+void gather_stats(void) {
+#ifdef FITZ_STATS
+    for (int i = 0; i < STAT_COUNT; i++) {
+        __atomic_fetch_add(&gatheredStats[i], threadStats[i],
+                __ATOMIC_RELAXED);
+        threadStats[i] = 0;
+    }
+#endif
+}
+
+/*
+ * Take the hot-path counts of every thread since the last call, this
+ * thread's included. Threads still running keep theirs until they finish.
+ * Param: counts - the STAT_COUNT counts to fill in; all 0 in builds without
+ *                 FITZ_STATS
+ */
+void take_stats(long* counts) {
+    gather_stats();
+    for (int i = 0; i < STAT_COUNT; i++) {
+#ifdef FITZ_STATS
+        counts[i] = __atomic_exchange_n(&gatheredStats[i], 0,
+                __ATOMIC_RELAXED);
+#else
+        counts[i] = 0;
+#endif
+    }
+}
+
+/*
+ * Mark the anchors blocked by one '!' of a tile. The '!' at column j of a tile
+ * row lands on cell (anchor + j) of the padded row, so shifting the occupied
+ * row right by j lines blocked cells up with the anchors they block.
+ * Param: line - the padded occupied row under the tile row
+ *        shift - the column j of the '!' in the tile row
+ *        blocked - the anchors blocked so far, updated in place
+ *        words - number of words to update
+ */
+void block_anchors(uint64_t* line, int shift, uint64_t* blocked, int words) {
+    int k = 0;
+#if defined(__AVX2__)
+    // Shift counts of 64 give 0, so shift 0 needs no special case here
+    __m128i right = _mm_cvtsi32_si128(shift);
+    __m128i left = _mm_cvtsi32_si128(WORD_BITS - shift);
+    for (; k + 4 <= words; k += 4) {
+        __m256i low = _mm256_loadu_si256((__m256i*) (line + k));
+        __m256i high = _mm256_loadu_si256((__m256i*) (line + k + 1));
+        __m256i old = _mm256_loadu_si256((__m256i*) (blocked + k));
+        __m256i bits = _mm256_or_si256(_mm256_srl_epi64(low, right),
+                _mm256_sll_epi64(high, left));
+        _mm256_storeu_si256((__m256i*) (blocked + k),
+                _mm256_or_si256(old, bits));
+    }
+#elif defined(__SSE2__)
+    __m128i right = _mm_cvtsi32_si128(shift);
+    __m128i left = _mm_cvtsi32_si128(WORD_BITS - shift);
+    for (; k + 2 <= words; k += 2) {
+        __m128i low = _mm_loadu_si128((__m128i*) (line + k));
+        __m128i high = _mm_loadu_si128((__m128i*) (line + k + 1));
+        __m128i old = _mm_loadu_si128((__m128i*) (blocked + k));
+        __m128i bits = _mm_or_si128(_mm_srl_epi64(low, right),
+                _mm_sll_epi64(high, left));
+        _mm_storeu_si128((__m128i*) (blocked + k), _mm_or_si128(old, bits));
+    }
+#endif
+    for (; k < words; k++) {
+        uint64_t bits = line[k] >> shift;
+        if (shift) {
+            bits |= line[k + 1] << (WORD_BITS - shift);
+        }
+        blocked[k] |= bits;
+    }
+}
+
+/*
+ * Work out up to SPAN_WORDS words of anchors in one row of a sparse board,
+ * as legal_span() does. The rows under the tile are read a word, i.e. a
+ * chunk, at a time. If every chunk is empty, or one row of the tile lies
+ * only on full words, the anchors are known without working them out.
+ * Param: tile - the rotation to place
+ *        board - the sparse board to place the tile on
+ *        row - the anchor row, from -MIDDLE to height + MIDDLE - 1
+ *        first, words - the range of words of the row to work out
+ *        legal - where to store the words
+ */
+void sparse_span(uint8_t* tile, Board* board, int row, int first, int words,
+        uint64_t* legal) {
+    uint64_t lines[TILE_SIZE][SPAN_WORDS + 1];
+    int empty = 1, full = 0;
+    for (int i = 0; i < TILE_SIZE; i++) {
+        if (!tile[i]) {
+            continue;
+        }
+        uint64_t all = ~(uint64_t) 0, any = 0;
+        for (int k = 0; k <= words; k++) {
+            lines[i][k] = row_word(board, PLANE_OCCUPIED, row + i - MIDDLE,
+                    first + k);
+            all &= lines[i][k];
+            any |= lines[i][k];
+        }
+        empty = empty && !any;
+        full = full || all == ~(uint64_t) 0;
+    }
+    if (empty || full) {
+        memset(legal, empty ? 0xFF : 0, sizeof(uint64_t) * words);
+        return;
+    }
+    memset(legal, 0, sizeof(uint64_t) * words);
+    for (int i = 0; i < TILE_SIZE; i++) {
+        for (int j = 0; j < TILE_SIZE; j++) {
+            if (tile[i] & (1 << j)) {
+                block_anchors(lines[i], j, legal, words);
+            }
+        }
+    }
+    for (int k = 0; k < words; k++) {
+        legal[k] = ~legal[k];
+    }
+}
+
+/*
+ * Work out some of the anchors in one row where a tile rotation can be
+ * placed, i.e. erode the free space of the board by the tile shape.
+ * Param: tile - the rotation to place
+ *        board - the board to place the tile on
+ *        row - the anchor row, from -MIDDLE to height + MIDDLE - 1
+ *        first, words - the range of words of the row to work out
+ *        legal - where to store the words. Bit (column + MIDDLE) of the row
+ *                is set if valid_place() would pass at (row, column)
+ */
+void legal_span(uint8_t* tile, Board* board, int row, int first, int words,
+        uint64_t* legal) {
+    if (board->chunks != NULL) {
+        for (int k = 0; k < words; k += SPAN_WORDS) {
+            sparse_span(tile, board, row, first + k,
+                    words - k < SPAN_WORDS ? words - k : SPAN_WORDS,
+                    legal + k);
+        }
+        return;
+    }
+    memset(legal, 0, sizeof(uint64_t) * words);
+    for (int i = 0; i < TILE_SIZE; i++) {
+        uint64_t* line = board_row(board, board->occupied, row + i - MIDDLE);
+        for (int j = 0; j < TILE_SIZE; j++) {
+            if (tile[i] & (1 << j)) {
+                block_anchors(line + first, j, legal, words);
+            }
+        }
+    }
+    for (int k = 0; k < words; k++) {
+        legal[k] = ~legal[k];
+    }
+}
+
+/*
+ * Work out every anchor in one row where a tile rotation can be placed
+ * Param: tile - the rotation to place
+ *        board - the board to place the tile on
+ *        row - the anchor row, from -MIDDLE to height + MIDDLE - 1
+ *        legal - board->stride words to store the result in, laid out as in
+ *                legal_span()
+ */
+void legal_row(uint8_t* tile, Board* board, int row, uint64_t* legal) {
+    legal_span(tile, board, row, 0, board->stride - 1, legal);
+    legal[board->stride - 1] = 0;
+}
+
+/*
+ * Count the set bits of a range of words
+ * Param: bits - the words to count
+ *        words - the number of words
+ * Return: the number of set bits
+ */
+long count_bits(uint64_t* bits, size_t words) {
+    long count = 0;
+    for (size_t k = 0; k < words; k++) {
+        count += __builtin_popcountll(bits[k]);
+    }
+    return count;
+}
+
+/*
+ * Build the legal-move index of a board for all tiles. The index is left out
+ * if it would take more than INDEX_LIMIT bytes, or the board is sparse;
+ * everything still works without it, only slower.
+ * Param: board - the board to index, with its cells already set
+ *        tiles - collection of all tiles
+ */
+void build_index(Board* board, AllTiles* tiles) {
+    int rows = board->height + 2 * MIDDLE;
+    size_t mapSize = (size_t) rows * board->stride;
+    size_t slotCount = 0;
+    for (int t = 0, shapes = 0; t < tiles->size; t++) {
+        Tile* tile = &tiles->allTiles[t];
+        if (tile->shape == shapes) {
+            // The first tile of its shape
+            shapes++;
+            for (int r = 0; r < 4; r++) {
+                slotCount += tile->same[r] == r;
+            }
+        }
+    }
+    if (board->chunks != NULL ||
+            mapSize * sizeof(uint64_t) * slotCount > INDEX_LIMIT) {
+        board->index = NULL;
+        return;
+    }
+    MoveIndex* index = (MoveIndex*) malloc(sizeof(MoveIndex) +
+            (sizeof(uint64_t) * mapSize + sizeof(long) + sizeof(uint8_t*)) *
+            slotCount + sizeof(int) * 4 * tiles->shapes);
+    index->tiles = tiles;
+    index->mapSize = mapSize;
+    index->slotCount = (int) slotCount;
+    index->maps = (uint64_t*) (index + 1);
+    index->counts = (long*) (index->maps + mapSize * slotCount);
+    index->rotations = (uint8_t**) (index->counts + slotCount);
+    index->slots = (int*) (index->rotations + slotCount);
+    for (int t = 0, n = 0, shapes = 0; t < tiles->size; t++) {
+        Tile* tile = &tiles->allTiles[t];
+        if (tile->shape != shapes) {
+            continue; // Shares the maps of an earlier tile
+        }
+        shapes++;
+        for (int r = 0; r < 4; r++) {
+            if (tile->same[r] != r) {
+                index->slots[tile->shape * 4 + r] =
+                        index->slots[tile->shape * 4 + tile->same[r]];
+                continue;
+            }
+            uint64_t* map = index->maps + n * mapSize;
+            for (int row = 0; row < rows; row++) {
+                legal_row(tile->rotations[r], board, row - MIDDLE,
+                        map + (size_t) row * board->stride);
+            }
+            index->counts[n] = count_bits(map, mapSize);
+            index->rotations[n] = tile->rotations[r];
+            index->slots[tile->shape * 4 + r] = n++;
+        }
+    }
+    board->index = index;
+}
+
+/*
+ * Bring the legal-move index up to date after cells around an anchor changed.
+ * Only anchors within REACH rows and columns of it can be affected, which is
+ * at most two words in each of 2 * REACH + 1 rows per rotation.
+ * Param: board - the board whose index to update
+ *        row, column - the anchor the cells changed around
+ */
+void update_index(Board* board, int row, int column) {
+    MoveIndex* index = board->index;
+    int firstRow = row - REACH < -MIDDLE ? -MIDDLE : row - REACH;
+    int lastRow = row + REACH > board->height + MIDDLE - 1 ?
+            board->height + MIDDLE - 1 : row + REACH;
+    int firstBit = column + MIDDLE - REACH < 0 ? 0 :
+            column + MIDDLE - REACH;
+    int lastBit = column + MIDDLE + REACH > board->width + 2 * MIDDLE - 1 ?
+            board->width + 2 * MIDDLE - 1 : column + MIDDLE + REACH;
+    if (firstRow > lastRow || firstBit > lastBit) {
+        return;
+    }
+    int first = firstBit / WORD_BITS, words = lastBit / WORD_BITS - first + 1;
+    uint64_t fresh[2];
+    for (int n = 0; n < index->slotCount; n++) {
+        uint8_t* tile = index->rotations[n];
+        uint64_t* map = index->maps + n * index->mapSize;
+        for (int r = firstRow; r <= lastRow; r++) {
+            uint64_t* legal = map + (size_t) (r + MIDDLE) * board->stride +
+                    first;
+            legal_span(tile, board, r, first, words, fresh);
+            for (int k = 0; k < words; k++) {
+                index->counts[n] += __builtin_popcountll(fresh[k]) -
+                        __builtin_popcountll(legal[k]);
+                legal[k] = fresh[k];
+            }
+        }
+    }
+}
+
+/*
+ * Get the indexed legal anchors of a tile rotation
+ * Param: board - the board to place the tile on
+ *        tile - the tile to place
+ *        degrees - 0, 90, 180, or 270 degrees to rotate in
+ *        count - set to the number of legal anchors if the map is indexed
+ * Return: the map laid out as in legal_row(), or NULL if it is not indexed
+ */
+uint64_t* index_map(Board* board, Tile* tile, int degrees, long* count) {
+    MoveIndex* index = board->index;
+    if (index == NULL || tile < index->tiles->allTiles ||
+            tile >= index->tiles->allTiles + index->tiles->size) {
+        return NULL;
+    }
+    size_t n = index->slots[tile->shape * 4 + degrees / 90];
+    *count = index->counts[n];
+    return index->maps + n * index->mapSize;
+}
+
+/*
+ * Check whether any '!' of a tile would be off the board
+ * Param: tile - the tile to put
+ *        board - the board to place the tile on
+ *        row, column - where to place the tile on the board
+ * Return: 1 if a '!' is off the board; 0 if every one is on it
+ */
+int off_board(uint8_t* tile, Board* board, int row, int column) {
+    for (int i = 0; i < TILE_SIZE; i++) {
+        if (tile[i] && (row + i - MIDDLE < 0 ||
+                row + i - MIDDLE >= board->height ||
+                column + __builtin_ctz(tile[i]) - MIDDLE < 0 ||
+                column + 31 - __builtin_clz(tile[i]) - MIDDLE >=
+                board->width)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Check whether the placement is valid
+ * Param: tile - the tile to put
+ *        board - the board to place the tile on
+ *        row, column - where to place the tile on the board
+ * Return: 1 if it is a valid placement; 0 if it is not.
+ */
+int valid_place(uint8_t* tile, Board* board, int row, int column) {
+    COUNT_STAT(STAT_VALID, 1);
+    if (row < -MIDDLE || row >= board->height + MIDDLE ||
+            column < -MIDDLE || column >= board->width + MIDDLE) {
+        // Every '!' would be off the board, beyond the margin
+        COUNT_STAT(STAT_OFF_BOARD, !empty_tile(tile));
+        return empty_tile(tile);
+    }
+    int bit = column - MIDDLE + MARGIN;
+    for (int i = 0; board->chunks != NULL && i < TILE_SIZE; i++) {
+        if (read_cells(board, PLANE_OCCUPIED, row + i - MIDDLE, bit) &
+                tile[i]) {
+            COUNT_STAT(off_board(tile, board, row, column) ?
+                    STAT_OFF_BOARD : STAT_OVERLAP, 1);
+            return 0;
+        }
+    }
+    for (int i = 0; board->chunks == NULL && i < TILE_SIZE; i++) {
+        // Off-board cells are occupied, so this also catches going off board
+        uint64_t* line = board_row(board, board->occupied, row + i - MIDDLE);
+        if (get_window(line, bit) & tile[i]) {
+            COUNT_STAT(off_board(tile, board, row, column) ?
+                    STAT_OFF_BOARD : STAT_OVERLAP, 1);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Place the tile.
+ * Param: tile - the tile to put
+ *        board - the board to place the tile on
+ *        row, column - where to put the tile on the board
+ *        type - the pattern of the tile. FIRST_TYPE ('*') or SECOND_TYPE ('#')
+ */
+void put_tile(uint8_t* tile, Board* board, int row, int column, char type) {
+    for (int i = 0; i < TILE_SIZE; i++) {
+        if (tile[i]) {
+            int bit = column - MIDDLE + MARGIN;
+            change_cells(board, PLANE_OCCUPIED, row + i - MIDDLE, bit,
+                    tile[i], 1);
+            if (type == SECOND_TYPE) {
+                change_cells(board, PLANE_SECOND, row + i - MIDDLE, bit,
+                        tile[i], 1);
+            }
+        }
+    }
+    hash_tile(tile, board, row, column);
+    if (board->index && !empty_tile(tile)) {
+        update_index(board, row, column);
+    }
+}
+
+/*
+ * Take a tile off the board, undoing put_tile()
+ * Param: tile - the tile to take off
+ *        board - the board the tile is on
+ *        row, column - where the tile was put on the board
+ */
+void take_tile(uint8_t* tile, Board* board, int row, int column) {
+    for (int i = 0; i < TILE_SIZE; i++) {
+        if (tile[i]) {
+            int bit = column - MIDDLE + MARGIN;
+            change_cells(board, PLANE_OCCUPIED, row + i - MIDDLE, bit,
+                    tile[i], 0);
+            change_cells(board, PLANE_SECOND, row + i - MIDDLE, bit,
+                    tile[i], 0);
+        }
+    }
+    hash_tile(tile, board, row, column);
+    if (board->index && !empty_tile(tile)) {
+        update_index(board, row, column);
+    }
+}
+
+/*
+ * Read a line from user input or a file
+ * Param: file - pointer to a FILE object to read
+ *        buffer - the buffer to read into, grown as needed and reused
+ * Return: The line got from the stream, valid until buffer is next used, or
+ *         NULL if the stream ends before the line does
+ */
+char* read_line(FILE* file, LineBuffer* buffer) {
+    int n = 0, next = fgetc(file);
+    if (buffer->max == 0) {
+        buffer->max = MAX;
+        buffer->line = (char*) malloc(sizeof(char) * buffer->max);
+    }
+    while (next != '\n') {
+        if (n >= buffer->max - 1) {
+            buffer->max *= 2;
+            buffer->line = (char*) realloc(buffer->line,
+                    sizeof(char) * buffer->max);
+        }
+        if (next == EOF) {
+            return NULL;
+        }
+        buffer->line[n] = (char) next;
+        n++;
+        next = getc(file);
+    }
+    buffer->line[n] = '\0';
+    return buffer->line;
+}
+
+/*
+ * Find the first set bit of a row in a range
+ * Param: bits - the row to search
+ *        from, to - the range of bits to search, inclusive
+ *        reverse - search from right to left if 1; left to right if 0
+ * Return: the bit found, or -1 if no bit in the range is set
+ */
+int first_bit(uint64_t* bits, int from, int to, int reverse) {
+    if (from > to) {
+        return -1;
+    }
+    int first = from / WORD_BITS, last = to / WORD_BITS;
+    for (int n = 0; n <= last - first; n++) {
+        int word = reverse ? last - n : first + n;
+        uint64_t found = bits[word];
+        if (word == first) {
+            found &= ~(uint64_t) 0 << (from % WORD_BITS);
+        }
+        if (word == last) {
+            found &= ~(uint64_t) 0 >> (WORD_BITS - 1 - to % WORD_BITS);
+        }
+        if (found) {
+            return word * WORD_BITS + (reverse ? WORD_BITS - 1 -
+                    __builtin_clzll(found) : __builtin_ctzll(found));
+        }
+    }
+    return -1;
+}
+
+/*
+ * Move an anchor to where a one-at-a-time scan would first reach the board.
+ * Anchors range from -MIDDLE to height/width + MIDDLE - 1. A non-empty tile
+ * never fits outside that range, so a scan starting outside it is the same
+ * as one starting from the first anchor inside it that the scan steps onto.
+ * Param: board - the board to scan
+ *        row, column - the anchor to move
+ *        reverse - 1 for a right to left, bottom to top scan
+ */
+void scan_start(Board* board, int* row, int* column, int reverse) {
+    int lastRow = board->height + MIDDLE - 1;
+    int lastCol = board->width + MIDDLE - 1;
+    while (*row < -MIDDLE || *row > lastRow || *column < -MIDDLE ||
+            *column > lastCol) {
+        if (reverse) {
+            if (*row > lastRow) {
+                *row = lastRow, *column = lastCol;
+            } else if (*row < -MIDDLE) {
+                // Step once, wrapping to the bottom row
+                *column = *column - 1 < -MIDDLE ? lastCol : *column - 1;
+                *row = lastRow;
+            } else if (*column > lastCol) {
+                *column = lastCol;
+            } else {
+                *column = lastCol;
+                *row = *row - 1 < -MIDDLE ? lastRow : *row - 1;
+            }
+        } else {
+            if (*row < -MIDDLE) {
+                *row = *column = -MIDDLE;
+            } else if (*row > lastRow) {
+                // Step once, wrapping to the top row
+                *column = *column + 1 > lastCol ? -MIDDLE : *column + 1;
+                *row = -MIDDLE;
+            } else if (*column < -MIDDLE) {
+                *column = -MIDDLE;
+            } else {
+                *column = -MIDDLE;
+                *row = *row + 1 > lastRow ? -MIDDLE : *row + 1;
+            }
+        }
+    }
+}
+
+/*
+ * Count the free cells of a padded board row, once per scan
+ * Param: board - the board to scan
+ *        padded - the padded row
+ *        freeCells - free cells of each padded board row, or -1 if not yet
+ *                    counted
+ * Return: the number of free cells
+ */
+int row_free(Board* board, int padded, int* freeCells) {
+    if (freeCells[padded] < 0) {
+        long count = 0;
+        if (board->chunks == NULL) {
+            count = count_bits(board->occupied +
+                    (size_t) padded * board->stride, board->stride);
+        }
+        for (int k = 0; board->chunks != NULL && k < board->stride; k++) {
+            count += __builtin_popcountll(row_word(board, PLANE_OCCUPIED,
+                    padded - MARGIN, k));
+        }
+        freeCells[padded] = board->stride * WORD_BITS - (int) count;
+    }
+    return freeCells[padded];
+}
+
+/*
+ * Check whether the board rows under a tile rotation have enough free cells
+ * for its rows
+ * Param: cells - the number of '!' cells in each row of the rotation
+ *        bounds - the bounds of its '!' cells, as in Tile
+ *        board - the board to place the tile on
+ *        row - the anchor row; the rotation must not hang off the board
+ *        freeCells - as in row_free()
+ * Return: 1 if every row may fit; 0 if the rotation fits nowhere in the row
+ */
+int rows_free(int* cells, uint8_t* bounds, Board* board, int row,
+        int* freeCells) {
+    for (int i = bounds[0]; i <= bounds[2]; i++) {
+        if (row_free(board, row - MIDDLE + i + MARGIN, freeCells) <
+                cells[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Set up a scan for the first anchor where one of some rotations fits
+ * Param: as for scan_board()
+ */
+void init_scan(Scan* scan, uint8_t** rotations, uint8_t** bounds,
+        uint64_t** maps, int count, Board* board, int row, int column,
+        int reverse) {
+    scan->rotations = rotations;
+    scan->bounds = bounds;
+    scan->maps = maps;
+    scan->count = count;
+    scan->board = board;
+    scan->rows = board->height + 2 * MIDDLE;
+    scan->lastBit = board->width + 2 * MIDDLE - 1;
+    scan->startRow = row + MIDDLE;
+    scan->startBit = column + MIDDLE;
+    scan->reverse = reverse;
+    scan->indexed = 1;
+    for (int i = 0; i < count; i++) {
+        for (int k = 0; k < TILE_SIZE; k++) {
+            scan->cells[i][k] = __builtin_popcount(rotations[i][k]);
+        }
+        // The padded anchor rows and bits keeping every '!' on the board
+        scan->firstRow[i] = 2 * MIDDLE - bounds[i][0];
+        scan->lastRow[i] = board->height - 1 + 2 * MIDDLE - bounds[i][2];
+        scan->firstBit[i] = 2 * MIDDLE - bounds[i][1];
+        scan->lastBits[i] = board->width - 1 + 2 * MIDDLE - bounds[i][3];
+        scan->indexed &= maps[i] != NULL;
+    }
+}
+
+/*
+ * Work out the scratch space a thread running a scan needs: a row of legal
+ * anchors for each rotation, one to combine them in, and the free cells of
+ * each padded board row
+ * Param: scan - the scan
+ * Return: the number of words
+ */
+size_t scan_words(Scan* scan) {
+    return (size_t) scan->board->stride * (scan->count + 1) +
+            (sizeof(int) * (scan->board->height + 2 * MARGIN) +
+            sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+/*
+ * Get a thread ready to run a scan, with no free cells counted yet
+ * Param: scan - the scan
+ *        scratch - the thread's scratch space
+ */
+void clear_scan(Scan* scan, uint64_t* scratch) {
+    if (!scan->indexed) {
+        memset(scratch + (size_t) scan->board->stride * (scan->count + 1),
+                -1, sizeof(int) * (scan->board->height + 2 * MARGIN));
+    }
+}
+
+/*
+ * Take one step of a scan: look for a fit in one anchor row. Each row is
+ * checked for every anchor at once, from the index if there is one or with
+ * legal_row() otherwise. Anchors where a rotation would hang off the board
+ * are never looked at, nor are rows whose board rows have too few free
+ * cells for it; neither changes which anchor is found first.
+ * Param: scan - the scan
+ *        n - the step, from 0 to scan->rows: the start row from the start
+ *            anchor on, the rows after it, wrapping around the board, and
+ *            the start row again up to the start anchor
+ *        scratch - the thread's scratch space
+ *        row, column - set to the first anchor in the row where a rotation
+ *                      fits, if there is one
+ * Return: index of the first rotation that fits there, or -1 if none fits
+ *         anywhere in the row
+ */
+int scan_row(Scan* scan, int n, uint64_t* scratch, int* row, int* column) {
+    Board* board = scan->board;
+    int rows = scan->rows, lastBit = scan->lastBit, startBit = scan->startBit;
+    uint64_t* any = scratch + (size_t) scan->count * board->stride;
+    int* freeCells = (int*) (any + board->stride);
+    uint64_t* legal[4];
+    int padded = scan->reverse ? (scan->startRow - n + rows) % rows :
+            (scan->startRow + n) % rows;
+    int from = 0, to = lastBit;
+    if (n == 0) {
+        // The start row, from the start anchor on
+        scan->reverse ? (to = startBit) : (from = startBit);
+    } else if (n == rows) {
+        // Back to the start row, up to the start anchor
+        scan->reverse ? (from = startBit + 1) : (to = startBit - 1);
+    }
+    int live = 0, fromBit = lastBit, toBit = 0, tight = 0;
+    for (int i = 0; !scan->indexed && i < TILE_SIZE; i++) {
+        // A row with a whole tile row free fits every rotation's row
+        tight |= row_free(board, padded + i, freeCells) < TILE_SIZE;
+    }
+    for (int i = 0; i < scan->count; i++) {
+        legal[i] = NULL;
+        if (padded < scan->firstRow[i] || padded > scan->lastRow[i]) {
+            continue;
+        }
+        if (scan->maps[i]) {
+            legal[i] = scan->maps[i] + (size_t) padded * board->stride;
+        } else if (!tight || rows_free(scan->cells[i], scan->bounds[i],
+                board, padded - MIDDLE, freeCells)) {
+            legal[i] = scratch + (size_t) i * board->stride;
+            legal_row(scan->rotations[i], board, padded - MIDDLE, legal[i]);
+        } else {
+            continue;
+        }
+        fromBit = scan->firstBit[i] < fromBit ? scan->firstBit[i] : fromBit;
+        toBit = scan->lastBits[i] > toBit ? scan->lastBits[i] : toBit;
+        live++;
+    }
+    if (live == 0) {
+        return -1;
+    }
+    uint64_t* bits = NULL;
+    if (live == 1) {
+        for (int i = 0; i < scan->count; i++) {
+            bits = legal[i] ? legal[i] : bits;
+        }
+    } else {
+        bits = any;
+        memset(any, 0, sizeof(uint64_t) * board->stride);
+        for (int i = 0; i < scan->count; i++) {
+            for (int k = 0; legal[i] && k < board->stride; k++) {
+                any[k] |= legal[i][k];
+            }
+        }
+    }
+    int low = from > fromBit ? from : fromBit, high = to < toBit ? to : toBit;
+    int bit = first_bit(bits, low, high, scan->reverse);
+    COUNT_STAT(STAT_ANCHORS, bit < 0 ? (high >= low ? high - low + 1 : 0) :
+            scan->reverse ? high - bit + 1 : bit - low + 1);
+    if (bit < 0) {
+        return -1;
+    }
+    int found = 0;
+    while (legal[found] == NULL ||
+            !(legal[found][bit / WORD_BITS] >> (bit % WORD_BITS) & 1)) {
+        found++;
+    }
+    *row = padded - MIDDLE;
+    *column = bit - MIDDLE;
+    return found;
+}
+
+/*
+ * Run the steps of a scan a pool hands out, one chunk at a time, until the
+ * chunks run out or an earlier chunk than the next has a fit
+ * Param: pool - the pool running the scan
+ *        id - the thread running them
+ */
+void scan_chunks(ScanPool* pool, int id) {
+    Scan* scan = pool->scan;
+    uint64_t* scratch = pool->scratch[id];
+    ScanResult* result = &pool->results[id];
+    result->chunk = pool->chunks;
+    clear_scan(scan, scratch);
+    while (1) {
+        int chunk = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+        if (chunk >= pool->chunks ||
+                chunk > __atomic_load_n(&pool->best, __ATOMIC_RELAXED)) {
+            return;
+        }
+        int first = pool->first + chunk * SCAN_CHUNK;
+        int last = first + SCAN_CHUNK - 1 < scan->rows ?
+                first + SCAN_CHUNK - 1 : scan->rows;
+        for (int n = first; n <= last &&
+                chunk < __atomic_load_n(&pool->best, __ATOMIC_RELAXED); n++) {
+            int found = scan_row(scan, n, scratch, &result->row,
+                    &result->column);
+            if (found >= 0) {
+                result->chunk = chunk;
+                result->found = found;
+                int best = __atomic_load_n(&pool->best, __ATOMIC_RELAXED);
+                while (chunk < best && !__atomic_compare_exchange_n(
+                        &pool->best, &best, chunk, 0, __ATOMIC_RELAXED,
+                        __ATOMIC_RELAXED)) {
+                }
+                return; // Every chunk left is later than this fit
+            }
+        }
+    }
+}
+
+/*
+ * A thread of a scan pool: run its part of every scan started, until the
+ * pool closes
+ * Param: data - the thread's ScanWorker
+ * Return: NULL
+ */
+void* scan_worker(void* data) {
+    ScanWorker* worker = (ScanWorker*) data;
+    ScanPool* pool = worker->pool;
+    long round = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (1) {
+        while (!pool->closing && pool->round == round) {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+        }
+        if (pool->closing) {
+            break;
+        }
+        round = pool->round;
+        pthread_mutex_unlock(&pool->lock);
+        scan_chunks(pool, worker->id);
+        gather_stats();
+        pthread_mutex_lock(&pool->lock);
+        if (--pool->busy == 0) {
+            pthread_cond_signal(&pool->done);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+/*
+ * Start threads to scan huge boards with
+ * Param: threads - the threads to scan with, counting the one starting the
+ *                  scans, or 0 for one per core
+ * Return: the pool, or NULL if it would have no threads of its own
+ */
+ScanPool* new_scan_pool(int threads) {
+    if (threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores < 1 ? 1 : cores > SCAN_THREADS ? SCAN_THREADS :
+                (int) cores;
+    }
+    threads = threads > SCAN_THREADS ? SCAN_THREADS : threads;
+    if (threads < 2) {
+        return NULL;
+    }
+    ScanPool* pool = (ScanPool*) calloc(1, sizeof(ScanPool));
+    pool->threads = threads - 1;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pthread_cond_init(&pool->done, NULL);
+    for (int i = 0; i < pool->threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].id = i;
+        pthread_create(&pool->workers[i].thread, NULL, scan_worker,
+                &pool->workers[i]);
+    }
+    return pool;
+}
+
+/*
+ * Stop the threads of a scan pool and free it
+ * Param: pool - the pool, or NULL
+ */
+void free_scan_pool(ScanPool* pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->closing = 1;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    for (int i = 0; i <= pool->threads; i++) {
+        free(pool->scratch[i]);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    pthread_cond_destroy(&pool->done);
+    free(pool);
+}
+
+/*
+ * Run the rest of a scan on a pool, the starting thread taking part
+ * Param: pool - the pool
+ *        scan - the scan
+ *        first - the first step left
+ *        row, column - set to the anchor found
+ * Return: index of the first rotation that fits at the anchor found, or -1
+ *         if none fits anywhere in the steps left
+ */
+int pool_scan(ScanPool* pool, Scan* scan, int first, int* row, int* column) {
+    size_t words = scan_words(scan);
+    if (words > pool->scratchWords) {
+        for (int i = 0; i <= pool->threads; i++) {
+            free(pool->scratch[i]);
+            pool->scratch[i] = (uint64_t*) malloc(sizeof(uint64_t) * words);
+        }
+        pool->scratchWords = words;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->scan = scan;
+    pool->first = first;
+    pool->chunks = (scan->rows - first + SCAN_CHUNK) / SCAN_CHUNK;
+    pool->next = 0;
+    pool->best = pool->chunks;
+    pool->busy = pool->threads;
+    pool->round++;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    scan_chunks(pool, pool->threads);
+    pthread_mutex_lock(&pool->lock);
+    while (pool->busy > 0) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    ScanResult* best = NULL;
+    for (int i = 0; i <= pool->threads; i++) {
+        ScanResult* result = &pool->results[i];
+        if (result->chunk < pool->chunks &&
+                (best == NULL || result->chunk < best->chunk)) {
+            best = result;
+        }
+    }
+    if (best == NULL) {
+        return -1;
+    }
+    *row = best->row;
+    *column = best->column;
+    return best->found;
+}
+
+/*
+ * Find the first anchor, in scanning order, where one of the given rotations
+ * can be placed. The scan goes along the rows from the start anchor, wraps
+ * around the board, and stops before coming back to the start anchor. With
+ * a pool, the first SCAN_CHUNK rows are scanned here and the rest, if need
+ * be, by the pool.
+ * Param: rotations - the rotations to try at each anchor, in order
+ *        bounds - the bounds of each rotation's '!' cells, as in Tile
+ *        maps - the indexed legal anchors of each rotation, or NULL for the
+ *               ones to work out here
+ *        count - the number of rotations
+ *        board - the board to place the tile on
+ *        row, column - the start anchor, within the anchor range. Set to the
+ *                      anchor found
+ *        reverse - 1 to scan right to left, bottom to top; 0 to scan left to
+ *                  right, top to bottom
+ *        pool - threads to scan with, or NULL to scan on this thread only
+ * Return: index of the first rotation that fits at the anchor found, or -1
+ *         if none fits anywhere
+ */
+int scan_board(uint8_t** rotations, uint8_t** bounds, uint64_t** maps,
+        int count, Board* board, int* row, int* column, int reverse,
+        ScanPool* pool) {
+    Scan scan;
+    COUNT_STAT(STAT_ROTATIONS, count);
+    init_scan(&scan, rotations, bounds, maps, count, board, *row, *column,
+            reverse);
+    size_t words = scan_words(&scan);
+    uint64_t local[SCAN_WORDS];
+    uint64_t* scratch = words <= SCAN_WORDS ? local :
+            (uint64_t*) malloc(sizeof(uint64_t) * words);
+    clear_scan(&scan, scratch);
+    int steps = pool && SCAN_CHUNK < scan.rows ? SCAN_CHUNK : scan.rows + 1;
+    int found = -1;
+    for (int n = 0; n < steps && found < 0; n++) {
+        found = scan_row(&scan, n, scratch, row, column);
+    }
+    if (found < 0 && steps <= scan.rows) {
+        found = pool_scan(pool, &scan, steps, row, column);
+    }
+    if (scratch != local) {
+        free(scratch);
+    }
+    return found;
+}
+
+/*
+ * Get the rotations of a tile worth scanning for, in order: those that
+ * differ from every earlier rotation and aren't known from the legal-move
+ * index to fit nowhere. A rotation repeating an earlier one fits at exactly
+ * the same anchors, so a scan never needs it.
+ * Param: board - the board to place the tile on
+ *        currentTile - the tile to place
+ *        rotations - set to the rotations
+ *        bounds - set to the bounds of their '!' cells
+ *        maps - set to the indexed legal anchors of each, or NULL
+ *        degrees - set to how far each is rotated
+ * Return: the number of rotations
+ */
+int distinct_rotations(Board* board, Tile* currentTile, uint8_t** rotations,
+        uint8_t** bounds, uint64_t** maps, int* degrees) {
+    int count = 0;
+    for (int r = 0; r < 4; r++) {
+        long anchors = 1;
+        uint64_t* map = index_map(board, currentTile, r * 90, &anchors);
+        if (currentTile->same[r] == r && anchors > 0) {
+            rotations[count] = currentTile->rotations[r];
+            bounds[count] = currentTile->bounds[r];
+            maps[count] = map;
+            degrees[count++] = r * 90;
+        }
+    }
+    return count;
+}
+
+/*
+ * Get the rotated tile
+ * Param: degrees - 0, 90, 180, or 270 degrees to rotate in
+ *        currentTile - the original tile to rotate
+ * Return: the rotated tile
+ */
+uint8_t* rotate_tile(int degrees, Tile* currentTile) {
+    switch (degrees) {
+        case 0:
+            return currentTile->rotations[0];
+        case 90:
+            return currentTile->rotations[1];
+        case 180:
+            return currentTile->rotations[2];
+    }
+    return currentTile->rotations[3];
+}
+
+/*
+ * Check whether the current player (human or auto 1) can win in this turn
+ * Param: currentTile - the tile to check possible placements of
+ *        board - the board to play on
+ *        currentPlayer - the player who will play in this turn if they can win
+ *        anotherPlayer - the other player
+ *        turn - the turn counts starting at 1
+ *        human - the player is human or auto type 1
+ * Return: 1 if no valid placements anymore i.e. the game ends.
+ *         0 if there exists a possible valid placement and game continues
+ */
+int game_end1(Tile* currentTile, Board* board, Player* currentPlayer,
+        Player* anotherPlayer, int turn, int human) {
+    int degree = 0, row, col;
+    if (turn == 1) {
+        row = MIDDLE * (-1), col = MIDDLE * (-1);
+    } else {
+        // Most recent legal move by either player i.e. the other player
+        row = anotherPlayer->rowStart, col = anotherPlayer->colStart;
+    }
+    if (!empty_tile(currentTile->rotations[0])) {
+        // An empty tile fits at the first anchor tried, wherever that is
+        scan_start(board, &row, &col, 0);
+        for (; degree <= 270; degree += 90) {
+            if (currentTile->same[degree / 90] != degree / 90) {
+                continue; // Fits nowhere, like the rotation it repeats
+            }
+            uint8_t* tile = rotate_tile(degree, currentTile);
+            long count = 0;
+            uint64_t* map = index_map(board, currentTile, degree, &count);
+            int foundRow = row, foundCol = col;
+            if (map && count == 0) {
+                continue; // Known to fit nowhere without scanning
+            }
+            uint8_t* bounds = currentTile->bounds[degree / 90];
+            if (scan_board(&tile, &bounds, &map, 1, board, &foundRow,
+                    &foundCol, 0, NULL) >= 0) {
+                row = foundRow, col = foundCol;
+                break;
+            }
+        }
+        if (degree > 270) {
+            return 1;
+        }
+    }
+    if (!human) {
+        currentPlayer->rowStart = row;
+        currentPlayer->colStart = col;
+        currentPlayer->validDegree = degree;
+    }
+    return 0; // Valid placement exists
+}
+
+/*
+ * Check whether the current player (auto 2) can win in this turn. The board
+ * is scanned on the player's scan pool if they have one.
+ * Param: currentTile - the tile to check possible placements of
+ *        board - the board to play on
+ *        currentPlayer - the player who will play in this turn if they can win
+ * Return: 1 if no valid placements anymore i.e. the game ends.
+ *         0 if there exists a possible valid placement and game continues
+ */
+int game_end2(Tile* currentTile, Board* board, Player* player) {
+    int row = player->rowStart, col = player->colStart, degree = 0;
+    // The second player search from right to left, bottom to top
+    int reverse = player->order == 1;
+    if (!empty_tile(currentTile->rotations[0])) {
+        // An empty tile fits at the first anchor tried, wherever that is
+        uint8_t* rotations[4];
+        uint8_t* bounds[4];
+        uint64_t* maps[4];
+        int degrees[4];
+        int count = distinct_rotations(board, currentTile, rotations, bounds,
+                maps, degrees);
+        if (count == 0) {
+            return 1; // Known to fit nowhere without scanning
+        }
+        scan_start(board, &row, &col, reverse);
+        int found = scan_board(rotations, bounds, maps, count, board, &row,
+                &col, reverse, player->pool);
+        if (found < 0) {
+            return 1;
+        }
+        degree = degrees[found];
+    }
+    player->rowStart = row;
+    player->colStart = col;
+    player->validDegree = degree;
+    return 0;
+}
+
+/*
+ * Check whether a tile can be placed anywhere on the board. This takes no
+ * scanning when the tile is in the legal-move index.
+ * Param: board - the board to place the tile on
+ *        currentTile - the tile to place
+ * Return: 1 if the tile fits somewhere; 0 if it does not
+ */
+int has_move(Board* board, Tile* currentTile) {
+    uint8_t* rotations[4];
+    uint8_t* bounds[4];
+    uint64_t* maps[4];
+    int degrees[4];
+    int row = -MIDDLE, column = -MIDDLE;
+    int count = distinct_rotations(board, currentTile, rotations, bounds,
+            maps, degrees);
+    if (count == 0 || empty_tile(currentTile->rotations[0])) {
+        return count > 0;
+    }
+    return scan_board(rotations, bounds, maps, count, board, &row, &column,
+            0, NULL) >= 0;
+}
+
+/*
+ * Count the legal placements of a tile from the legal-move index
+ * Param: board - the board to place the tile on
+ *        tile - the tile to place
+ * Return: the number of legal (anchor, rotation) pairs, or -1 if the tile is
+ *         not indexed
+ */
+long count_moves(Board* board, Tile* tile) {
+    long count, total = 0;
+    for (int degree = 0; degree <= 270; degree += 90) {
+        if (index_map(board, tile, degree, &count) == NULL) {
+            return -1;
+        }
+        total += count;
+    }
+    return total;
+}
+
+/*
+ * Count the legal placements of one rotation of a tile, from the legal-move
+ * index or else row by row
+ * Param: board - the board to place the tile on
+ *        tile - the tile to place
+ *        rotation - the rotation: rotated rotation * 90 degrees
+ * Return: the number of legal anchors
+ */
+long rotation_moves(Board* board, Tile* tile, int rotation) {
+    long count = 0;
+    if (index_map(board, tile, rotation * 90, &count) != NULL) {
+        return count;
+    }
+    uint64_t* legal = (uint64_t*) malloc(sizeof(uint64_t) * board->stride);
+    for (int row = -MIDDLE; row < board->height + MIDDLE; row++) {
+        legal_row(tile->rotations[rotation], board, row, legal);
+        count += count_bits(legal, board->stride);
+    }
+    free(legal);
+    return count;
+}
+
+/*
+ * Build the search state of a search player
+ * Return: the new state, with an empty transposition table
+ */
+Search* new_search(void) {
+    Search* search = (Search*) malloc(sizeof(Search));
+    search->table = (TableEntry*) calloc((size_t) 1 << TABLE_BITS,
+            sizeof(TableEntry));
+    search->roots = (Move*) malloc(sizeof(Move) * 5 * SEARCH_ROOT_MOVES);
+    search->rootCount = 0;
+    return search;
+}
+
+/*
+ * Free the search state of a search player
+ * Param: search - the state to free, or NULL
+ */
+void free_search(Search* search) {
+    if (search) {
+        free(search->table);
+        free(search->roots);
+        free(search);
+    }
+}
+
+/*
+ * Get the key of the position being searched: the board, the tile to place
+ * and the player to place it.
+ * Param: search - the search in progress
+ * Return: the key
+ */
+uint64_t position_key(Search* search) {
+    return search->board->hash ^ mix_hash(((uint64_t) search->current << 1) |
+            (uint64_t) search->side);
+}
+
+/*
+ * Pack a transposition table entry into 64 bits: score (16), depth (4),
+ * bound (2), rotation (2), column + MIDDLE (20) and row + MIDDLE (20)
+ * Param: score, depth, bound - the search result
+ *        move - the best move found
+ * Return: the packed entry
+ */
+uint64_t pack_entry(int score, int depth, int bound, Move move) {
+    return (uint64_t) (uint16_t) score << 48 | (uint64_t) depth << 44 |
+            (uint64_t) bound << 42 | (uint64_t) move.rotation << 40 |
+            (uint64_t) (move.column + MIDDLE) << 20 |
+            (uint64_t) (move.row + MIDDLE);
+}
+
+/*
+ * Look a position up in the transposition table
+ * Param: search - the search in progress
+ *        key - the key of the position
+ *        data - set to the packed entry if found
+ * Return: 1 if the position was found; 0 if not
+ */
+int probe_table(Search* search, uint64_t key, uint64_t* data) {
+    TableEntry* entry = &search->table[key & (((uint64_t) 1 << TABLE_BITS) -
+            1)];
+    uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+    *data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    return (check ^ *data) == key;
+}
+
+/*
+ * Store a position in the transposition table, replacing what was there
+ * Param: search - the search in progress
+ *        key - the key of the position
+ *        data - the packed entry
+ */
+void store_table(Search* search, uint64_t key, uint64_t data) {
+    TableEntry* entry = &search->table[key & (((uint64_t) 1 << TABLE_BITS) -
+            1)];
+    __atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+}
+
+/*
+ * Score a position without searching: the placements the player to move has
+ * left, less those the other player has for the tile after.
+ * Param: search - the search in progress
+ * Return: the score for the player to move
+ */
+int evaluate(Search* search) {
+    AllTiles* tiles = search->tiles;
+    long mine = count_moves(search->board,
+            &tiles->allTiles[search->current]);
+    long theirs = count_moves(search->board,
+            &tiles->allTiles[(search->current + 1) % tiles->size]);
+    if (mine < 0 || theirs < 0) {
+        return 0; // Not indexed: only wins and losses are scored
+    }
+    long score = mine - theirs;
+    return score > WIN / 2 ? WIN / 2 : score < -WIN / 2 ? -WIN / 2 :
+            (int) score;
+}
+
+int negamax(Search* search, int depth, int alpha, int beta, int ply,
+        Move* best);
+
+/*
+ * Check whether a timed search has run out of time, giving up if it has
+ * Param: search - the search in progress
+ * Return: 1 if the search has given up; 0 if not
+ */
+int out_of_time(Search* search) {
+    if (search->deadline > 0 && !search->aborted &&
+            now_seconds() > search->deadline) {
+        search->aborted = 1;
+    }
+    return search->aborted;
+}
+
+/*
+ * Make a move, search the position after it and unmake the move
+ * Param: search - the search in progress
+ *        move - the move to make; it must be legal
+ *        depth - moves left to search after this one
+ *        alpha, beta - the search window for the player making the move
+ *        ply - moves made since the root of the search
+ * Return: the score of the move for the player making it; meaningless if
+ *         search->aborted was set
+ */
+int search_move(Search* search, Move move, int depth, int alpha, int beta,
+        int ply) {
+    if (out_of_time(search)) {
+        return 0; // Before putting the tile updates the index
+    }
+    Tile* tile = &search->tiles->allTiles[search->current];
+    uint8_t* rotation = tile->rotations[move.rotation];
+    put_tile(rotation, search->board, move.row, move.column,
+            search->side ? SECOND_TYPE : FIRST_TYPE);
+    search->current = (search->current + 1) % search->tiles->size;
+    search->side = !search->side;
+    int score = -negamax(search, depth, -beta, -alpha, ply + 1, NULL);
+    search->side = !search->side;
+    search->current = (search->current + search->tiles->size - 1) %
+            search->tiles->size;
+    take_tile(rotation, search->board, move.row, move.column);
+    return score;
+}
+
+/*
+ * Search a move of a position and keep it if it is the best so far
+ * Param: search - the search in progress
+ *        move - the move to search; it must be legal
+ *        depth - moves left to search after this one
+ *        alpha - the lower end of the search window, raised by a better move
+ *        beta - the upper end of the search window
+ *        ply - moves made since the root of the search
+ *        bestScore, bestMove - the best move so far and its score
+ * Return: 1 if the move was searched; 0 if the search gave up
+ */
+int try_move(Search* search, Move move, int depth, int* alpha, int beta,
+        int ply, int* bestScore, Move* bestMove) {
+    int score = search_move(search, move, depth, *alpha, beta, ply);
+    if (search->aborted) {
+        return 0;
+    }
+    if (score > *bestScore) {
+        *bestScore = score;
+        *bestMove = move;
+        *alpha = score > *alpha ? score : *alpha;
+    }
+    return 1;
+}
+
+/*
+ * Search a position with negamax and alpha-beta pruning. Moves are tried
+ * anchor by anchor from the legal-move maps, or from search->roots at the
+ * root if it was given some, best move from the transposition table first.
+ * Param: search - the search in progress
+ *        depth - moves left to search
+ *        alpha, beta - the search window
+ *        ply - moves made since the root of the search
+ *        best - set to the best move found, or NULL if not needed. Left as
+ *               it was if no move was searched to the end
+ * Return: the score of the position for the player to move; meaningless if
+ *         search->aborted was set
+ */
+int negamax(Search* search, int depth, int alpha, int beta, int ply,
+        Move* best) {
+    Board* board = search->board;
+    Tile* tile = &search->tiles->allTiles[search->current];
+    uint64_t key = position_key(search), data;
+    Move tableMove = {0, 0, -1};
+    if ((++search->nodes > search->limit && best == NULL) ||
+            out_of_time(search)) {
+        search->aborted = 1;
+        return 0;
+    }
+    if (probe_table(search, key, &data)) {
+        int score = (int16_t) (data >> 48), bound = (data >> 42) & 3;
+        score += score > WIN / 2 ? -ply : score < -WIN / 2 ? ply : 0;
+        if ((int) (data >> 44 & 15) >= depth && best == NULL &&
+                (bound == EXACT || (bound == LOWER && score >= beta) ||
+                (bound == UPPER && score <= alpha))) {
+            return score;
+        }
+        tableMove.row = (int) (data & 0xFFFFF) - MIDDLE;
+        tableMove.column = (int) (data >> 20 & 0xFFFFF) - MIDDLE;
+        tableMove.rotation = (int) (data >> 40 & 3);
+    }
+    if (depth == 0) {
+        return has_move(board, tile) ? evaluate(search) : ply - WIN;
+    }
+    int original = alpha, bestScore = -WIN - 1;
+    Move bestMove = {0, 0, -1};
+    if (tableMove.rotation >= 0 && valid_place(
+            tile->rotations[tableMove.rotation], board, tableMove.row,
+            tableMove.column)) {
+        bestScore = search_move(search, tableMove, depth - 1, alpha, beta,
+                ply);
+        bestMove = tableMove;
+        alpha = bestScore > alpha ? bestScore : alpha;
+    }
+    for (int n = 0; ply == 0 && n < search->rootCount && alpha < beta; n++) {
+        Move move = search->roots[n];
+        if ((move.row != tableMove.row || move.column != tableMove.column ||
+                move.rotation != tableMove.rotation) && !try_move(search,
+                move, depth - 1, &alpha, beta, ply, &bestScore, &bestMove)) {
+            break;
+        }
+    }
+    uint64_t* buffer = NULL; // For rows of rotations not in the index
+    int lastBit = board->width + 2 * MIDDLE - 1;
+    int every = ply > 0 || search->rootCount == 0;
+    for (int rotation = 0; every && rotation < 4 && alpha < beta;
+            rotation++) {
+        if (tile->same[rotation] != rotation) {
+            continue; // The same moves as the rotation it repeats
+        }
+        long count = 0;
+        uint64_t* map = index_map(board, tile, rotation * 90, &count);
+        for (int row = 0; row < board->height + 2 * MIDDLE && alpha < beta &&
+                !out_of_time(search) && (map == NULL || count > 0); row++) {
+            uint64_t* legal = map ? map + (size_t) row * board->stride :
+                    buffer;
+            if (map == NULL) {
+                if (buffer == NULL) {
+                    legal = buffer = (uint64_t*) malloc(sizeof(uint64_t) *
+                            board->stride);
+                }
+                legal_row(tile->rotations[rotation], board, row - MIDDLE,
+                        legal);
+            }
+            // Searching a move restores the map before the next bit is read
+            for (int bit = first_bit(legal, 0, lastBit, 0); bit >= 0 &&
+                    alpha < beta && !search->aborted;
+                    bit = first_bit(legal, bit + 1, lastBit, 0)) {
+                Move move = {row - MIDDLE, bit - MIDDLE, rotation};
+                if (move.row == tableMove.row &&
+                        move.column == tableMove.column &&
+                        move.rotation == tableMove.rotation) {
+                    continue;
+                }
+                if (!try_move(search, move, depth - 1, &alpha, beta, ply,
+                        &bestScore, &bestMove)) {
+                    break;
+                }
+            }
+        }
+    }
+    free(buffer);
+    if (bestMove.rotation < 0) {
+        // No legal move, unless the search gave up before finding one
+        return search->aborted ? 0 : ply - WIN;
+    }
+    if (best) {
+        *best = bestMove;
+    }
+    if (!search->aborted) {
+        int bound = bestScore <= original ? UPPER : bestScore >= beta ?
+                LOWER : EXACT;
+        int stored = bestScore + (bestScore > WIN / 2 ? ply :
+                bestScore < -WIN / 2 ? -ply : 0);
+        store_table(search, key, pack_entry(stored, depth, bound, bestMove));
+    }
+    return bestScore;
+}
+
+/*
+ * Choose the root moves of a timed search when there are more legal moves
+ * than it could search to even one move deep in time. Moves hemmed in by
+ * tiles or the edge go first: those with the most of their four
+ * neighbouring anchors of the same rotation illegal, then in scan order.
+ * Param: search - the search about to start
+ * Return: the number of moves put in search->roots; 0 to search every legal
+ *         move, as there are few enough or the tile isn't indexed
+ */
+int choose_roots(Search* search) {
+    Board* board = search->board;
+    Tile* tile = &search->tiles->allTiles[search->current];
+    uint64_t* maps[4];
+    int counts[5] = {0}; // Moves kept with 0 to 4 illegal neighbours
+    long total = 0, count;
+    for (int rotation = 0; rotation < 4; rotation++) {
+        maps[rotation] = index_map(board, tile, rotation * 90, &count);
+        if (maps[rotation] == NULL) {
+            return 0;
+        }
+        total += tile->same[rotation] == rotation ? count : 0;
+    }
+    if (total <= SEARCH_ROOT_MOVES) {
+        return 0;
+    }
+    int rows = board->height + 2 * MIDDLE, words = board->stride;
+    for (int rotation = 0; rotation < 4; rotation++) {
+        for (int row = 0; tile->same[rotation] == rotation && row < rows;
+                row++) {
+            uint64_t* legal = maps[rotation] + (size_t) row * words;
+            for (int k = 0; k < words; k++) {
+                uint64_t bits = legal[k];
+                if (bits == 0) {
+                    continue;
+                }
+                // Bit j of each is set if that neighbour of anchor j is legal
+                uint64_t left = bits << 1 | (k > 0 ? legal[k - 1] >> 63 : 0);
+                uint64_t right = bits >> 1 |
+                        (k + 1 < words ? legal[k + 1] << 63 : 0);
+                uint64_t up = row > 0 ? legal[k - words] : 0;
+                uint64_t down = row + 1 < rows ? legal[k + words] : 0;
+                uint64_t open = bits & left & right & up & down;
+                if (counts[0] == SEARCH_ROOT_MOVES) {
+                    bits &= ~open; // Enough open moves kept already
+                }
+                for (; bits; bits &= bits - 1) {
+                    uint64_t bit = bits & -bits;
+                    int level = !(left & bit) + !(right & bit) + !(up & bit) +
+                            !(down & bit);
+                    if (counts[level] < SEARCH_ROOT_MOVES) {
+                        Move move = {row - MIDDLE, k * WORD_BITS +
+                                __builtin_ctzll(bit) - MIDDLE, rotation};
+                        search->roots[(4 - level) * SEARCH_ROOT_MOVES +
+                                counts[level]++] = move;
+                    }
+                }
+            }
+        }
+    }
+    int kept = 0;
+    for (int level = 4; level >= 0 && kept < SEARCH_ROOT_MOVES; level--) {
+        int n = counts[level] < SEARCH_ROOT_MOVES - kept ? counts[level] :
+                SEARCH_ROOT_MOVES - kept;
+        memmove(search->roots + kept,
+                search->roots + (4 - level) * SEARCH_ROOT_MOVES,
+                sizeof(Move) * n);
+        kept += n;
+    }
+    return kept;
+}
+
+/*
+ * A search player picks a move. The first placement that fits is found
+ * first, so a move is ready whenever the search stops. Then it searches one
+ * move deeper at a time until the result is known or its budget is spent:
+ * up to SEARCH_DEPTH moves and a number of positions, or up to
+ * SEARCH_MAX_DEPTH moves and a number of milliseconds. A timed search with
+ * more legal moves than it could search tries only those choose_roots()
+ * picks. It plays the best move of the deepest search, even one cut short,
+ * as that tries the best move of the search before first.
+ * Param: tiles - collection of all tiles
+ *        board - the board to play on
+ *        player - the search player; the move is stored as for auto players
+ * Return: 1 if there is no legal move i.e. the game ends; 0 otherwise
+ */
+int search_turn(AllTiles* tiles, Board* board, Player* player) {
+    Search* search = player->search;
+    Move best = {0, 0, -1};
+    double start = now_seconds();
+    player->rowStart = player->colStart = -MIDDLE;
+    if (game_end2(&tiles->allTiles[tiles->current], board, player)) {
+        return 1;
+    }
+    search->board = board;
+    search->tiles = tiles;
+    search->current = tiles->current;
+    search->side = player->order;
+    search->nodes = search->aborted = 0;
+    search->limit = player->timed ? LONG_MAX : player->budget;
+    search->deadline = player->timed ? start + player->budget / 1000.0 : 0;
+    search->rootCount = player->timed ? choose_roots(search) : 0;
+    int depth = 0, deepest = player->timed ? SEARCH_MAX_DEPTH : SEARCH_DEPTH;
+    while (depth < deepest && !search->aborted) {
+        int score = negamax(search, depth + 1, -WIN - 1, WIN + 1, 0, &best);
+        depth += !search->aborted;
+        if (score > WIN / 2 || score < -WIN / 2) {
+            break; // Won or lost whatever happens next
+        }
+    }
+    if (best.rotation >= 0) {
+        // Otherwise it gave up before a single move was searched
+        player->rowStart = best.row;
+        player->colStart = best.column;
+        player->validDegree = best.rotation * 90;
+    }
+    double seconds = now_seconds() - start;
+    if (player->report != NULL) {
+        fprintf(player->report, "Player %c search: depth %d, %ld positions "
+                "in %.3f s, %.0f positions/s\n",
+                player->order ? SECOND_TYPE : FIRST_TYPE, depth,
+                search->nodes, seconds,
+                seconds > 0 ? search->nodes / seconds : 0.0);
+    }
+    return 0;
+}
+
+/*
+ * Find a free cell of the endgame solver
+ * Param: keys - the free cells, each row * width + column, in order
+ *        count - the number of free cells
+ *        key - the cell to find
+ * Return: the index of the cell, or -1 if it isn't free
+ */
+int find_cell(long* keys, int count, long key) {
+    int low = 0, high = count - 1;
+    while (low <= high) {
+        int middle = (low + high) / 2;
+        if (keys[middle] == key) {
+            return middle;
+        } else if (keys[middle] < key) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return -1;
+}
+
+/*
+ * Find the free cells a legal placement covers
+ * Param: board - the board
+ *        rotation - the rotation placed
+ *        move - where it goes
+ *        keys, count - the free cells, as for find_cell()
+ *        cells - set to the indices of the cells covered
+ * Return: the number of cells covered
+ */
+int placement_cells(Board* board, uint8_t* rotation, Move move, long* keys,
+        int count, int* cells) {
+    int covered = 0;
+    for (int i = 0; i < TILE_SIZE; i++) {
+        for (int j = 0; j < TILE_SIZE; j++) {
+            if (rotation[i] >> j & 1) {
+                cells[covered++] = find_cell(keys, count,
+                        (long) (move.row + i - MIDDLE) * board->width +
+                        move.column + j - MIDDLE);
+            }
+        }
+    }
+    return covered;
+}
+
+/*
+ * Find the root of the set of free cells a cell is in, halving the path
+ * Param: parent - the parent of each cell; a root is its own parent
+ *        cell - the cell
+ * Return: the root
+ */
+int find_root(int* parent, int cell) {
+    while (parent[cell] != cell) {
+        parent[cell] = parent[parent[cell]];
+        cell = parent[cell];
+    }
+    return cell;
+}
+
+/*
+ * Order placements by shape, then region, then cells, for qsort()
+ * Param: a, b - the placements
+ * Return: negative, zero or positive as a goes before, with or after b
+ */
+int compare_placements(const void* a, const void* b) {
+    const Placement* p = (const Placement*) a;
+    const Placement* q = (const Placement*) b;
+    if (p->shape != q->shape) {
+        return p->shape - q->shape;
+    } else if (p->region != q->region) {
+        return p->region - q->region;
+    }
+    return (p->cells > q->cells) - (p->cells < q->cells);
+}
+
+/*
+ * List the free cells of a board, if there are few enough to solve
+ * Param: board - the board
+ *        keys - set to the free cells, each row * width + column, in order
+ * Return: the number of free cells, or -1 if there are more than
+ *         ENDGAME_FREE
+ */
+int free_cells(Board* board, long* keys) {
+    int count = 0;
+    for (int row = 0; row < board->height; row++) {
+        // The margin is occupied, so every clear bit is a cell on the board
+        for (int word = 0; word < board->stride; word++) {
+            uint64_t bits = ~row_word(board, PLANE_OCCUPIED, row, word);
+            for (; bits; bits &= bits - 1) {
+                if (count == ENDGAME_FREE) {
+                    return -1;
+                }
+                keys[count++] = (long) row * board->width + word * WORD_BITS +
+                        __builtin_ctzll(bits) - MARGIN;
+            }
+        }
+    }
+    return count;
+}
+
+/*
+ * Number the free cells a tile can still go in region by region, and work
+ * out which regions have the same shape
+ * Param: endgame - the solver, with its placements found
+ *        keys, count - the free cells, as for find_cell()
+ *        parent - the sets of cells placements join, as for find_root()
+ *        bit - set to the number of each cell; -1 marks cells no placement
+ *              covers, which are left that way
+ *        width - the width of the board
+ * Return: the number of cells numbered, or -1 if there are more than
+ *         WORD_BITS
+ */
+int number_cells(Endgame* endgame, long* keys, int count, int* parent,
+        int* bit, int width) {
+    int regionOf[ENDGAME_FREE]; // By root
+    int next[WORD_BITS]; // The next number of each region
+    long cellKeys[WORD_BITS];
+    int live = 0;
+    endgame->regionCount = 0;
+    memset(regionOf, -1, sizeof(regionOf));
+    for (int c = 0; c < count; c++) {
+        if (bit[c] >= 0) {
+            if (++live > WORD_BITS) {
+                return -1;
+            }
+            int root = find_root(parent, c);
+            if (regionOf[root] < 0) {
+                regionOf[root] = endgame->regionCount;
+                endgame->regions[endgame->regionCount++].size = 0;
+            }
+            endgame->regions[regionOf[root]].size++;
+        }
+    }
+    for (int r = 0, first = 0; r < endgame->regionCount; r++) {
+        endgame->regions[r].first = next[r] = first;
+        first += endgame->regions[r].size;
+    }
+    for (int c = 0; c < count; c++) {
+        if (bit[c] >= 0) {
+            bit[c] = next[regionOf[find_root(parent, c)]]++;
+            cellKeys[bit[c]] = keys[c];
+        }
+    }
+    for (int r = 0; r < endgame->regionCount; r++) {
+        Region* region = &endgame->regions[r];
+        region->twin = r;
+        for (int t = 0; t < r && region->twin == r; t++) {
+            // A twin is the same cells moved by a whole number of rows and
+            // columns
+            Region* other = &endgame->regions[t];
+            long* mine = &cellKeys[region->first];
+            long* theirs = &cellKeys[other->first];
+            int same = other->size == region->size && other->twin == t;
+            for (int k = 1; k < region->size && same; k++) {
+                same = mine[k] / width - mine[0] / width ==
+                        theirs[k] / width - theirs[0] / width &&
+                        mine[k] % width - mine[0] % width ==
+                        theirs[k] % width - theirs[0] % width;
+            }
+            region->twin = same ? t : r;
+        }
+    }
+    return live;
+}
+
+/*
+ * Work out how many empty tiles come before the next non-empty one. An
+ * empty tile fits anywhere and changes nothing, so it just passes the turn.
+ * Param: endgame - the solver
+ * Return: 1 if worked out; 0 if every tile is empty
+ */
+int count_empty(Endgame* endgame) {
+    AllTiles* tiles = endgame->tiles;
+    int solid = tiles->size - 1;
+    while (solid >= 0 && empty_tile(tiles->allTiles[solid].rotations[0])) {
+        solid--;
+    }
+    if (solid < 0) {
+        return 0;
+    }
+    endgame->solid = (int*) malloc(sizeof(int) * tiles->size);
+    for (int k = 0, t = solid, empty = 0; k < tiles->size; k++) {
+        empty = t == solid ? 0 : empty_tile(tiles->allTiles[t].rotations[0]) ?
+                empty + 1 : 0;
+        endgame->solid[t] = empty;
+        t = (t + tiles->size - 1) % tiles->size;
+    }
+    return 1;
+}
+
+/*
+ * Free what the endgame solver allocated
+ * Param: endgame - the solver, set up by build_endgame()
+ */
+void free_endgame(Endgame* endgame) {
+    free(endgame->placements);
+    free(endgame->first);
+    free(endgame->solid);
+    free(endgame->memo);
+}
+
+/*
+ * Set the endgame solver up for a board: find every placement of every
+ * tile, drop the free cells none covers and group the rest into regions
+ * Param: endgame - the solver to set up
+ *        board - the board
+ *        tiles - collection of all tiles
+ * Return: the number of free cells a tile can go in, or -1 if the board has
+ *         too many free cells or the tiles too many shapes to solve. Nothing
+ *         is left to free then.
+ */
+int build_endgame(Endgame* endgame, Board* board, AllTiles* tiles) {
+    long keys[ENDGAME_FREE];
+    int parent[ENDGAME_FREE], bit[ENDGAME_FREE], cells[TILE_SIZE * TILE_SIZE];
+    int shapeTile[ENDGAME_SHAPES];
+    int count = tiles->shapes > ENDGAME_SHAPES ? -1 : free_cells(board, keys);
+    endgame->tiles = tiles;
+    endgame->placements = NULL;
+    endgame->first = endgame->solid = NULL;
+    endgame->memo = NULL;
+    if (count < 0 || !count_empty(endgame)) {
+        return -1;
+    }
+    for (int t = tiles->size - 1; t >= 0; t--) {
+        shapeTile[tiles->allTiles[t].shape] = t;
+    }
+    for (int c = 0; c < count; c++) {
+        parent[c] = c;
+        bit[c] = -1;
+    }
+    int found = 0, max = 0;
+    for (int shape = 0; shape < tiles->shapes; shape++) {
+        Tile* tile = &tiles->allTiles[shapeTile[shape]];
+        for (int r = 0; r < 4 && !empty_tile(tile->rotations[0]); r++) {
+            uint8_t* rotation = tile->rotations[r];
+            int top = tile->bounds[r][0], left = __builtin_ctz(rotation[top]);
+            for (int c = 0; c < count && tile->same[r] == r; c++) {
+                // Found from the free cell its first '!' goes in
+                Move move = {(int) (keys[c] / board->width) - top + MIDDLE,
+                        (int) (keys[c] % board->width) - left + MIDDLE, r};
+                if (!valid_place(rotation, board, move.row, move.column)) {
+                    continue;
+                }
+                if (found == max) {
+                    max = max ? max * 2 : count;
+                    endgame->placements = (Placement*) realloc(
+                            endgame->placements, sizeof(Placement) * max);
+                }
+                Placement placement = {0, shape, 0, move};
+                endgame->placements[found++] = placement;
+                int covered = placement_cells(board, rotation, move, keys,
+                        count, cells);
+                for (int k = 0; k < covered; k++) {
+                    parent[find_root(parent, cells[k])] =
+                            find_root(parent, cells[0]);
+                    bit[cells[k]] = 0;
+                }
+            }
+        }
+    }
+    int live = number_cells(endgame, keys, count, parent, bit, board->width);
+    if (live < 0) {
+        free_endgame(endgame);
+        return -1;
+    }
+    int regionOf[WORD_BITS]; // By cell number
+    for (int r = 0; r < endgame->regionCount; r++) {
+        Region* region = &endgame->regions[r];
+        for (int k = 0; k < region->size; k++) {
+            regionOf[region->first + k] = r;
+        }
+    }
+    for (int n = 0; n < found; n++) {
+        Placement* placement = &endgame->placements[n];
+        Move move = placement->move;
+        int covered = placement_cells(board, tiles->allTiles[shapeTile[
+                placement->shape]].rotations[move.rotation], move, keys,
+                count, cells);
+        for (int k = 0; k < covered; k++) {
+            placement->cells |= (uint64_t) 1 << bit[cells[k]];
+        }
+        placement->region = regionOf[bit[cells[0]]];
+    }
+    if (found > 0) {
+        qsort(endgame->placements, found, sizeof(Placement),
+                compare_placements);
+    }
+    endgame->first = (int*) malloc(sizeof(int) * (tiles->shapes + 1));
+    int kept = 0;
+    for (int n = 0, shape = 0; n <= found; n++) {
+        while (shape < tiles->shapes && (n == found ||
+                endgame->placements[n].shape >= shape)) {
+            endgame->first[shape++] = kept;
+        }
+        if (n < found && (kept == 0 || endgame->placements[n].cells !=
+                endgame->placements[kept - 1].cells ||
+                endgame->placements[n].shape !=
+                endgame->placements[kept - 1].shape)) {
+            // Rotations of a tile can cover the same cells
+            endgame->placements[kept++] = endgame->placements[n];
+        }
+    }
+    endgame->first[tiles->shapes] = kept;
+    endgame->memo = (MemoEntry*) calloc((size_t) 1 << MEMO_BITS,
+            sizeof(MemoEntry));
+    endgame->nodes = endgame->aborted = 0;
+    return live;
+}
+
+/*
+ * Get the cells of a region from a set of the solver's cells
+ * Param: cells - the set
+ *        region - the region
+ * Return: the cells of the region in the set, its first cell at bit 0
+ */
+uint64_t region_cells(uint64_t cells, Region* region) {
+    uint64_t shifted = cells >> region->first;
+    return region->size == WORD_BITS ? shifted :
+            shifted & (((uint64_t) 1 << region->size) - 1);
+}
+
+/*
+ * Check whether an earlier region of the same shape has the same cells
+ * free. Moves in the region then lead to the same positions, up to which
+ * region is which, as moves there.
+ * Param: endgame - the solver
+ *        free - the free cells
+ *        r - the region
+ * Return: 1 if there is such a region; 0 if not
+ */
+int twin_free(Endgame* endgame, uint64_t free, int r) {
+    Region* region = &endgame->regions[r];
+    uint64_t mine = region_cells(free, region);
+    for (int t = region->twin; t < r; t++) {
+        if (endgame->regions[t].twin == region->twin &&
+                region_cells(free, &endgame->regions[t]) == mine) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Solve an endgame position exactly, remembering the positions solved
+ * Param: endgame - the solver
+ *        free - the cells a tile can still go in which are free
+ *        current - the tile to place next
+ *        best - set to a winning move if there is one, else to a legal move
+ *               if there is one, or NULL if not needed. Only given for a
+ *               non-empty tile.
+ * Return: 1 if the player to move wins; 0 if they lose or endgame->aborted
+ *         was set
+ */
+int solve_position(Endgame* endgame, uint64_t free, int current, Move* best) {
+    AllTiles* tiles = endgame->tiles;
+    int passes = endgame->solid[current];
+    current = (current + passes) % tiles->size;
+    if (++endgame->nodes > endgame->limit) {
+        endgame->aborted = 1;
+        return 0;
+    }
+    MemoEntry* entry = &endgame->memo[mix_hash(free ^ mix_hash(current)) &
+            (((uint64_t) 1 << MEMO_BITS) - 1)];
+    if (best == NULL && entry->current == current + 1 && entry->free == free) {
+        return entry->won ^ (passes & 1);
+    }
+    int shape = tiles->allTiles[current].shape, region = -1, twin = 0, won = 0;
+    int next = (current + 1) % tiles->size;
+    for (int n = endgame->first[shape]; n < endgame->first[shape + 1] &&
+            !won && !endgame->aborted; n++) {
+        Placement* placement = &endgame->placements[n];
+        if (placement->region != region) {
+            region = placement->region;
+            twin = twin_free(endgame, free, region);
+        }
+        if (!twin && (placement->cells & free) == placement->cells) {
+            won = !solve_position(endgame, free & ~placement->cells, next,
+                    NULL);
+            if (best != NULL && (won || best->rotation < 0)) {
+                *best = placement->move;
+            }
+        }
+    }
+    if (!endgame->aborted) {
+        entry->free = free;
+        entry->current = current + 1;
+        entry->won = won;
+    }
+    return won ^ (passes & 1);
+}
+
+/*
+ * Solve the end of a game exactly: whether the player to move wins however
+ * the other plays, and with which move. Only boards with few free cells and
+ * tiles of few shapes are solved. The free cells no tile fits in are
+ * dropped and the rest split into regions which no placement spans, so
+ * regions of the same shape and cells are searched once.
+ * Param: board - the board to play on
+ *        tiles - collection of all tiles
+ *        current - the tile to place next
+ *        limit - the most positions to visit
+ *        solution - set to what was found
+ * Return: SOLVE_WIN, SOLVE_LOSS, or SOLVE_UNKNOWN if there were too many
+ *         free cells or positions to solve
+ */
+int solve_endgame(Board* board, AllTiles* tiles, int current, long limit,
+        Solution* solution) {
+    Endgame endgame;
+    Move none = {0, 0, -1};
+    solution->result = SOLVE_UNKNOWN;
+    solution->move = none;
+    solution->cells = solution->regions = 0;
+    solution->nodes = 0;
+    int live = build_endgame(&endgame, board, tiles);
+    if (live < 0) {
+        return SOLVE_UNKNOWN;
+    }
+    endgame.limit = limit;
+    uint64_t free = live == WORD_BITS ? ~(uint64_t) 0 :
+            ((uint64_t) 1 << live) - 1;
+    Move best = none;
+    int won;
+    if (empty_tile(tiles->allTiles[current].rotations[0])) {
+        // An empty tile fits anywhere and changes nothing
+        won = !solve_position(&endgame, free, (current + 1) % tiles->size,
+                NULL);
+        best.rotation = 0;
+    } else {
+        won = solve_position(&endgame, free, current, &best);
+    }
+    solution->cells = live;
+    solution->regions = endgame.regionCount;
+    solution->nodes = endgame.nodes;
+    if (!endgame.aborted) {
+        solution->result = won ? SOLVE_WIN : SOLVE_LOSS;
+        solution->move = best;
+    }
+    free_endgame(&endgame);
+    return solution->result;
+}
+
+/*
+ * An endgame player picks a move. Once few enough cells are free it plays a
+ * move the endgame solver proves wins; until then, or if the game is lost,
+ * it plays as a search player.
+ * Param: tiles - collection of all tiles
+ *        board - the board to play on
+ *        player - the endgame player; the move is stored as for auto players
+ * Return: 1 if there is no legal move i.e. the game ends; 0 otherwise
+ */
+int endgame_turn(AllTiles* tiles, Board* board, Player* player) {
+    Solution solution;
+    if (solve_endgame(board, tiles, tiles->current, ENDGAME_NODES,
+            &solution) != SOLVE_WIN) {
+        return search_turn(tiles, board, player);
+    }
+    player->rowStart = solution.move.row;
+    player->colStart = solution.move.column;
+    player->validDegree = solution.move.rotation * 90;
+    return 0;
+}
+
+/*
+ * Get the time on a clock that only moves forward
+ * Return: the time in seconds
+ */
+double now_seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+ * Get the next number of a random sequence (xorshift64*)
+ * Param: state - the state of the sequence, never 0
+ * Return: the number
+ */
+uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * Copy the cells of a board onto a board of the same size
+ * Param: from - the board to copy
+ *        to - the board to copy onto; its index is not updated
+ */
+void copy_cells(Board* from, Board* to) {
+    to->hash = from->hash;
+    if (from->chunks == NULL) {
+        memcpy(to->occupied, from->occupied, sizeof(uint64_t) * 2 *
+                (from->height + 2 * MARGIN) * from->stride);
+        return;
+    }
+    // Chunks already allocated are kept, cleared if need be, for next time
+    size_t count = chunk_count(from);
+    for (size_t n = 0; n < count; n++) {
+        if (from->chunks[n] != NULL && to->chunks[n] == NULL) {
+            to->chunks[n] = (uint64_t*) malloc(sizeof(uint64_t) *
+                    2 * CHUNK_ROWS);
+        }
+        if (to->chunks[n] != NULL) {
+            if (from->chunks[n] != NULL) {
+                memcpy(to->chunks[n], from->chunks[n],
+                        sizeof(uint64_t) * 2 * CHUNK_ROWS);
+            } else {
+                memset(to->chunks[n], 0, sizeof(uint64_t) * 2 * CHUNK_ROWS);
+            }
+        }
+    }
+}
+
+/*
+ * Build a copy of a board, without a legal-move index
+ * Param: from - the board to copy
+ *        to - the board to build the copy in
+ */
+void copy_board(Board* from, Board* to) {
+    to->height = from->height;
+    to->width = from->width;
+    new_board(to);
+    copy_cells(from, to);
+}
+
+/*
+ * Pick a move the way an automatic player would, from a random anchor: AUTO_1
+ * or AUTO_2 order, scanning forwards or backwards
+ * Param: tile - the tile to place
+ *        board - the board to place it on
+ *        random - random number state
+ *        move - set to the move found
+ * Return: 1 if a move was found; 0 if the tile fits nowhere
+ */
+int random_move(Tile* tile, Board* board, uint64_t* random, Move* move) {
+    uint64_t bits = next_random(random);
+    Player player;
+    player.rowStart = (int) (bits % (board->height + 2 * MIDDLE)) - MIDDLE;
+    bits /= board->height + 2 * MIDDLE;
+    player.colStart = (int) (bits % (board->width + 2 * MIDDLE)) - MIDDLE;
+    bits /= board->width + 2 * MIDDLE;
+    player.order = bits & 1;
+    player.pool = NULL;
+    int end = (bits & 2) ? game_end1(tile, board, &player, &player, 2, 0) :
+            game_end2(tile, board, &player);
+    move->row = player.rowStart;
+    move->column = player.colStart;
+    move->rotation = player.validDegree / 90;
+    return !end;
+}
+
+/*
+ * Find distinct moves for a tree node with random_move()
+ * Param: tile - the tile to place
+ *        board - the board to place it on
+ *        random - random number state
+ *        moves - MCTS_WIDTH moves to store the moves found in
+ * Return: the number of moves found; 0 if the tile fits nowhere
+ */
+int mcts_candidates(Tile* tile, Board* board, uint64_t* random,
+        Move* moves) {
+    int count = 0;
+    for (int tries = 0; tries < 2 * MCTS_WIDTH && count < MCTS_WIDTH;
+            tries++) {
+        Move move;
+        if (!random_move(tile, board, random, &move)) {
+            return 0;
+        }
+        int seen = 0;
+        for (int i = 0; i < count; i++) {
+            seen |= moves[i].row == move.row &&
+                    moves[i].column == move.column &&
+                    moves[i].rotation == move.rotation;
+        }
+        if (!seen) {
+            moves[count++] = move;
+        }
+    }
+    return count;
+}
+
+/*
+ * Add a node to a thread's tree
+ * Param: worker - the thread
+ *        parent - the parent node, or -1 for the root
+ *        move - the move leading to the node
+ *        side - the player who made the move
+ * Return: the new node
+ */
+int new_node(MctsWorker* worker, int parent, Move move, int side) {
+    if (worker->count == worker->capacity) {
+        worker->capacity *= 2;
+        worker->nodes = (MctsNode*) realloc(worker->nodes,
+                sizeof(MctsNode) * worker->capacity);
+    }
+    MctsNode* node = &worker->nodes[worker->count];
+    node->move = move;
+    node->side = side;
+    node->parent = parent;
+    node->first = -1;
+    node->next = -1;
+    node->untried = 0;
+    node->visits = 0;
+    node->wins = 0;
+    if (parent >= 0) {
+        node->next = worker->nodes[parent].first;
+        worker->nodes[parent].first = worker->count;
+    }
+    return worker->count++;
+}
+
+/*
+ * Play a game out with random_move() until a player can't move
+ * Param: worker - the thread, whose board to play on
+ *        current - the tile to place next
+ *        side - the player to place it
+ * Return: the winner, or -1 if nobody can lose (only empty tiles are left)
+ */
+int playout(MctsWorker* worker, int current, int side) {
+    AllTiles* tiles = worker->mcts->tiles;
+    Board* board = &worker->board;
+    long limit = ((long) board->height * board->width + 1) * tiles->size;
+    for (long ply = 0; ply < limit; ply++) {
+        Tile* tile = &tiles->allTiles[current];
+        Move move;
+        if (!random_move(tile, board, &worker->random, &move)) {
+            return !side;
+        }
+        put_tile(tile->rotations[move.rotation], board, move.row,
+                move.column, side ? SECOND_TYPE : FIRST_TYPE);
+        current = (current + 1) % tiles->size;
+        side = !side;
+    }
+    return -1;
+}
+
+/*
+ * Run one playout: go down the tree by UCT, add a node, play the game out
+ * from it and count the result in every node on the way
+ * Param: worker - the thread
+ */
+void mcts_playout(MctsWorker* worker) {
+    Mcts* mcts = worker->mcts;
+    AllTiles* tiles = mcts->tiles;
+    int node = 0, current = mcts->current, side = mcts->side, winner;
+    copy_cells(mcts->board, &worker->board);
+    while (1) {
+        MctsNode* at = &worker->nodes[node];
+        Move move;
+        int child = -1;
+        if (at->untried > 0) {
+            int pick = (int) (next_random(&worker->random) % at->untried);
+            move = at->moves[pick];
+            at->moves[pick] = at->moves[--at->untried];
+        } else if (at->first < 0) {
+            winner = !side; // The player to move can't
+            break;
+        } else {
+            double best = -1, logVisits = log(at->visits);
+            for (int n = at->first; n >= 0; n = worker->nodes[n].next) {
+                MctsNode* option = &worker->nodes[n];
+                double value = option->wins / option->visits + MCTS_EXPLORE *
+                        sqrt(logVisits / option->visits);
+                if (value > best) {
+                    best = value;
+                    child = n;
+                }
+            }
+            move = worker->nodes[child].move;
+        }
+        Tile* tile = &tiles->allTiles[current];
+        put_tile(tile->rotations[move.rotation], &worker->board, move.row,
+                move.column, side ? SECOND_TYPE : FIRST_TYPE);
+        current = (current + 1) % tiles->size;
+        side = !side;
+        if (child >= 0) {
+            node = child;
+            continue;
+        }
+        node = new_node(worker, node, move, !side);
+        at = &worker->nodes[node];
+        at->untried = mcts_candidates(&tiles->allTiles[current],
+                &worker->board, &worker->random, at->moves);
+        winner = at->untried ? playout(worker, current, side) : !side;
+        break;
+    }
+    for (; node >= 0; node = worker->nodes[node].parent) {
+        worker->nodes[node].visits++;
+        worker->nodes[node].wins += winner < 0 ? 0.5 :
+                winner == worker->nodes[node].side;
+    }
+    worker->playouts++;
+}
+
+/*
+ * Run playouts in one thread until the budget is used up
+ * Param: data - the MctsWorker of the thread
+ * Return: NULL
+ */
+void* mcts_worker(void* data) {
+    MctsWorker* worker = (MctsWorker*) data;
+    Mcts* mcts = worker->mcts;
+    while (mcts->timed ? now_seconds() - mcts->start < mcts->budget / 1e3 :
+            worker->playouts < mcts->budget) {
+        mcts_playout(worker);
+    }
+    gather_stats();
+    return NULL;
+}
+
+/*
+ * An MCTS player picks a move. Every core runs playouts on a tree of its
+ * own (root parallelization), starting from the same candidate moves, and
+ * the move visited most across all trees is played.
+ * Param: tiles - collection of all tiles
+ *        board - the board to play on
+ *        player - the MCTS player; the move is stored as for auto players
+ * Return: 1 if there is no legal move i.e. the game ends; 0 otherwise
+ */
+int mcts_turn(AllTiles* tiles, Board* board, Player* player) {
+    Mcts mcts = {board, tiles, tiles->current, player->order};
+    uint64_t random = mix_hash(board->hash ^ (uint64_t) time(NULL)) | 1;
+    mcts.candidates = mcts_candidates(&tiles->allTiles[tiles->current], board,
+            &random, mcts.moves);
+    if (mcts.candidates == 0) {
+        return 1;
+    }
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : threads > MCTS_THREADS ? MCTS_THREADS :
+            threads;
+    mcts.timed = player->timed;
+    mcts.budget = player->timed ? player->budget :
+            (player->budget + threads - 1) / threads;
+    mcts.start = now_seconds();
+    MctsWorker workers[MCTS_THREADS];
+    for (int i = 0; i < threads; i++) {
+        MctsWorker* worker = &workers[i];
+        worker->mcts = &mcts;
+        copy_board(board, &worker->board);
+        worker->capacity = 1024;
+        worker->count = 0;
+        worker->nodes = (MctsNode*) malloc(sizeof(MctsNode) *
+                worker->capacity);
+        worker->random = mix_hash(random + i) | 1;
+        worker->playouts = 0;
+        new_node(worker, -1, mcts.moves[0], !player->order);
+        worker->nodes[0].untried = mcts.candidates;
+        memcpy(worker->nodes[0].moves, mcts.moves, sizeof(mcts.moves));
+        pthread_create(&worker->thread, NULL, mcts_worker, worker);
+    }
+    long visits[MCTS_WIDTH] = {0}, playouts = 0;
+    for (int i = 0; i < threads; i++) {
+        MctsWorker* worker = &workers[i];
+        pthread_join(worker->thread, NULL);
+        for (int n = worker->nodes[0].first; n >= 0;
+                n = worker->nodes[n].next) {
+            for (int m = 0; m < mcts.candidates; m++) {
+                if (memcmp(&mcts.moves[m], &worker->nodes[n].move,
+                        sizeof(Move)) == 0) {
+                    visits[m] += worker->nodes[n].visits;
+                }
+            }
+        }
+        playouts += worker->playouts;
+        free(worker->nodes);
+        free_board(&worker->board);
+    }
+    int best = 0;
+    for (int m = 1; m < mcts.candidates; m++) {
+        best = visits[m] > visits[best] ? m : best;
+    }
+    double seconds = now_seconds() - mcts.start;
+    if (player->report != NULL) {
+        fprintf(player->report, "Player %c MCTS: %ld playouts in %.3f s, "
+                "%.0f playouts/s on %ld threads\n",
+                player->order ? SECOND_TYPE : FIRST_TYPE, playouts, seconds,
+                seconds > 0 ? playouts / seconds : 0.0, threads);
+    }
+    player->rowStart = mcts.moves[best].row;
+    player->colStart = mcts.moves[best].column;
+    player->validDegree = mcts.moves[best].rotation * 90;
+    return 0;
+}
+
+/*
+ * Set the player's initial legal play position
+ * The second player who is auto type 2 starts at the bottom right corner
+ *      (board rows + 2, board columns + 2);
+ * Others (human player, auto type 1, the first auto 2) starts at the top left
+ *      (-2, -2)
+ */
+void set_start(Board* board, Player* player) {
+    if (player->type == AUTO_2 && player->order == 1) {
+        player->rowStart = board->height + MIDDLE;
+        player->colStart = board->width + MIDDLE;
+    } else {
+        player->rowStart = player->colStart = MIDDLE * (-1);
+    }
+}
+
+/*
+ * Find out whether the player to move can play, and pick the move of an
+ * automatic player without putting the tile. A human player picks their own.
+ * Param: game - the game to move in. An automatic player's move is stored in
+ *               their rowStart, colStart and validDegree
+ * Return: 1 if the game will end; 0 if it will continue
+ */
+int choose_move(Game* game) {
+    AllTiles* tiles = &game->tiles;
+    Board* board = &game->board;
+    Player* currentPlayer = &game->players[game->order];
+    Player* anotherPlayer = &game->players[!game->order];
+    Tile* currentTile = &(tiles->allTiles[tiles->current]);
+    int end = 0;
+    if (currentPlayer->type == HUMAN) {
+        end = !has_move(board, currentTile);
+    } else if (currentPlayer->type == SEARCH) {
+        end = search_turn(tiles, board, currentPlayer);
+    } else if (currentPlayer->type == MCTS) {
+        end = mcts_turn(tiles, board, currentPlayer);
+    } else if (currentPlayer->type == ENDGAME) {
+        end = endgame_turn(tiles, board, currentPlayer);
+    } else if (currentPlayer->type == AUTO_1) {
+        end = game_end1(currentTile, board, currentPlayer, anotherPlayer,
+                game->turn, 0);
+    } else {
+        if (currentPlayer->pool == NULL && currentPlayer->threads != 1 &&
+                (long) board->height * board->width >= PARALLEL_CELLS) {
+            currentPlayer->pool = new_scan_pool(currentPlayer->threads);
+            currentPlayer->threads = currentPlayer->pool ?
+                    currentPlayer->pool->threads + 1 : 1;
+        }
+        end = game_end2(currentTile, board, currentPlayer);
+    }
+    return end;
+}
+
+/*
+ * Analyse a position without playing on: the legal placements of the tile
+ * to place next and of the tile after, and what the automatic players would
+ * play next
+ * Param: game - the game, started or loaded
+ *        analysis - set to what was found
+ */
+void analyse_game(Game* game, Analysis* analysis) {
+    AllTiles* tiles = &game->tiles;
+    Board* board = &game->board;
+    Move none = {0, 0, -1};
+    for (int k = 0; k < 2; k++) {
+        Tile* tile = &tiles->allTiles[(tiles->current + k) % tiles->size];
+        analysis->mobility[k] = 0;
+        for (int r = 0; r < 4; r++) {
+            analysis->moves[k][r] = tile->same[r] == r ?
+                    rotation_moves(board, tile, r) :
+                    analysis->moves[k][tile->same[r]];
+            if (tile->same[r] == r) {
+                analysis->mobility[k] += analysis->moves[k][r];
+            }
+        }
+    }
+    Tile* tile = &tiles->allTiles[tiles->current];
+    Player player = game->players[game->order];
+    Player other = game->players[!game->order];
+    player.pool = NULL;
+    player.threads = 1;
+    Move* moves[2] = {&analysis->auto1, &analysis->auto2};
+    for (int type = AUTO_1; type <= AUTO_2; type++) {
+        // Each starts where it would if it had just loaded the game
+        player.type = type;
+        set_start(board, &player);
+        int end = type == AUTO_1 ? game_end1(tile, board, &player, &other,
+                game->turn, 0) : game_end2(tile, board, &player);
+        Move move = {player.rowStart, player.colStart,
+                player.validDegree / 90};
+        *moves[type - AUTO_1] = end ? none : move;
+    }
+}
+
+/*
+ * Put the current tile for the player to move, and pass the turn on. The
+ * move is kept in the game's history so that it can be taken back.
+ * Param: game - the game to move in
+ *        row, column - where the middle of the tile goes
+ *        degrees - how far the tile is rotated: 0, 90, 180 or 270
+ */
+void play_move(Game* game, int row, int column, int degrees) {
+    Player* player = &game->players[game->order];
+    AllTiles* tiles = &game->tiles;
+    History* history = &game->history;
+    if (history->count == history->max) {
+        history->max = history->max ? history->max * 2 : HISTORY_START;
+        history->moves = (Played*) realloc(history->moves,
+                sizeof(Played) * history->max);
+    }
+    Played played = {tiles->current, row, column, degrees, player->rowStart,
+            player->colStart, player->validDegree};
+    history->moves[history->count++] = played;
+    uint8_t* tile = rotate_tile(degrees, &(tiles->allTiles[tiles->current]));
+    put_tile(tile, &game->board, row, column,
+            game->order ? SECOND_TYPE : FIRST_TYPE);
+    player->rowStart = row;
+    player->colStart = column;
+    player->validDegree = degrees;
+    tiles->current++;
+    if (tiles->current >= tiles->size) {
+        // Run out of tiles. Start again at the beginning
+        tiles->current = 0;
+    }
+    game->order = game->order ? FIRST_PLAYER : SECOND_PLAYER;
+    game->turn++;
+    if (game->journal != NULL) {
+        journal_move(game->journal, game,
+                (tiles->current + tiles->size - 1) % tiles->size, row, column,
+                degrees);
+    }
+}
+
+/*
+ * Convert a word to or from little-endian, the byte order of binary saves
+ * Param: word - the word to convert
+ * Return: the converted word
+ */
+uint64_t little_endian(uint64_t word) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return __builtin_bswap64(word);
+#else
+    return word;
+#endif
+}
+
+/*
+ * Get the mask of the cells of a word block which are on the board
+ * Param: board - the board
+ *        word - the word of the row
+ * Return: the mask
+ */
+uint64_t word_mask(Board* board, int word) {
+    int left = board->width - word * WORD_BITS;
+    return left >= WORD_BITS ? ~(uint64_t) 0 : ((uint64_t) 1 << left) - 1;
+}
+
+/*
+ * Write the cells of a sparse board as SparseCells records. Only the word
+ * blocks overlapping an allocated chunk can hold occupied cells, so the
+ * chunks of each chunk row are listed once and only their blocks are read.
+ * Param: out - the stream to write to
+ *        board - the sparse board
+ */
+void save_sparse(FILE* out, Board* board) {
+    int words = (board->width + WORD_BITS - 1) / WORD_BITS;
+    int blocks = (board->height + 2 * MARGIN + CHUNK_ROWS - 1) / CHUNK_ROWS;
+    int* used = (int*) malloc(sizeof(int) * board->stride);
+    for (int block = 0; block < blocks; block++) {
+        int count = 0;
+        for (int word = 0; word < board->stride; word++) {
+            if (board->chunks[(size_t) block * board->stride + word]) {
+                used[count++] = word;
+            }
+        }
+        for (int r = 0; count > 0 && r < CHUNK_ROWS; r++) {
+            int row = block * CHUNK_ROWS + r - MARGIN;
+            if (row < 0 || row >= board->height) {
+                continue;
+            }
+            // Block k is made of padded words k and k + 1
+            for (int n = 0, next = 0; n < count; n++) {
+                int k = used[n] - 1 > next ? used[n] - 1 : next;
+                for (; k <= used[n] && k < words; k++) {
+                    int bit = k * WORD_BITS + MARGIN;
+                    SparseCells cells = {little_endian((uint64_t) row),
+                            little_endian((uint64_t) k),
+                            read_cells(board, PLANE_OCCUPIED, row, bit) &
+                            word_mask(board, k),
+                            read_cells(board, PLANE_SECOND, row, bit) &
+                            word_mask(board, k)};
+                    if (cells.occupied) {
+                        cells.occupied = little_endian(cells.occupied);
+                        cells.second = little_endian(cells.second);
+                        fwrite(&cells, sizeof(cells), 1, out);
+                    }
+                }
+                next = k;
+            }
+        }
+    }
+    free(used);
+}
+
+/*
+ * Save the game into a binary file, laid out as described at SaveHeader
+ * Param: path - the path of the file to save to
+ *        tiles - collection of all tiles, the current one to play next
+ *        player - the next player to have their turn (0 or 1)
+ *        board - the board to play on
+ * Return: 1 if the game was saved; 0 if the save file couldn't be opened
+ */
+int save_binary(char* path, AllTiles* tiles, int player, Board* board) {
+    FILE* outputFile = fopen(path, "wb");
+    if (outputFile == NULL) {
+        return 0;
+    }
+    SaveHeader header = {little_endian(board->chunks == NULL ? SAVE_MAGIC :
+            SPARSE_MAGIC),
+            little_endian((uint64_t) tiles->current),
+            little_endian((uint64_t) player),
+            little_endian((uint64_t) board->height),
+            little_endian((uint64_t) board->width),
+            little_endian(tiles->checksum)};
+    fwrite(&header, sizeof(header), 1, outputFile);
+    int words = (board->width + WORD_BITS - 1) / WORD_BITS;
+    uint64_t* cells = (uint64_t*) malloc(sizeof(uint64_t) * (2 * words + 1));
+    for (int row = 0; board->chunks == NULL && row < board->height; row++) {
+        for (int k = 0; k < words; k++) {
+            int bit = k * WORD_BITS + MARGIN;
+            cells[k] = little_endian(read_cells(board, PLANE_OCCUPIED, row,
+                    bit) & word_mask(board, k));
+            cells[words + k] = little_endian(read_cells(board, PLANE_SECOND,
+                    row, bit) & word_mask(board, k));
+        }
+        fwrite(cells, sizeof(uint64_t), 2 * words, outputFile);
+    }
+    free(cells);
+    if (board->chunks != NULL) {
+        save_sparse(outputFile, board);
+    }
+    fflush(outputFile);
+    fclose(outputFile);
+    return 1;
+}
+
+/*
+ * Save the game into a file: binary if the path ends in SAVE_SUFFIX, or the
+ * text format otherwise.
+ * Param: path - the path of the file to save to
+ *        tiles - collection of all tiles, the current one to play next
+ *        player - the next player to have their turn (0 or 1)
+ *        board - the board to play on
+ * Return: 1 if the game was saved; 0 if the save file couldn't be opened
+ */
+int save(char* path, AllTiles* tiles, int player, Board* board) {
+    size_t length = strlen(path), suffix = strlen(SAVE_SUFFIX);
+    if (length >= suffix && strcmp(path + length - suffix, SAVE_SUFFIX) == 0) {
+        return save_binary(path, tiles, player, board);
+    }
+    FILE* outputFile = fopen(path, "w");
+    if (outputFile == NULL) {
+        return 0;
+    }
+    fprintf(outputFile, "%d %d %d %d\n", tiles->current, player,
+            board->height, board->width);
+    print_board(outputFile, board);
+    fflush(outputFile);
+    fclose(outputFile);
+    return 1;
+}
+
+/*
+ * Play a line of input from a human player: a move "row column degrees",
+ * "save" followed by the path to save the game to, or "undo" to take back
+ * the player's last move and the moves since
+ * Param: game - the game the human player is to move in
+ *        line - the line entered
+ * Return: INPUT_MOVED if the move was legal and played, INPUT_SAVED or
+ *         INPUT_UNSAVED for a save command, INPUT_UNDONE if the player's last
+ *         move was taken back, or INPUT_INVALID otherwise
+ */
+int play_input(Game* game, char* line) {
+    int num[3] = {0};
+    char next;
+    char firstFour[5];
+    if (line[0] == ' ') {
+        return INPUT_INVALID;
+    }
+    strncpy(firstFour, line, 4);
+    firstFour[4] = '\0';
+    if (strcmp(line, "undo") == 0) {
+        return undo_turn(game) ? INPUT_UNDONE : INPUT_INVALID;
+    }
+    if (strcmp(firstFour, "save") == 0) {
+        // Save games
+        return save(line + 4, &game->tiles, game->order, &game->board) ?
+                INPUT_SAVED : INPUT_UNSAVED;
+    }
+    int status = sscanf(line, "%d%d%d%c", &num[0], &num[1], &num[2], &next);
+    if (status == 3) {
+        // The input is three space separated integers
+        int row = num[0], column = num[1], degree = num[2];
+        if (degree == 0 || degree == 90 || degree == 180 || degree == 270) {
+            // Valid degree
+            uint8_t* tile = rotate_tile(degree,
+                    &(game->tiles.allTiles[game->tiles.current]));
+            if (valid_place(tile, &game->board, row, column) == 1) {
+                play_move(game, row, column, degree);
+                return INPUT_MOVED;
+            }
+        }
+    }
+    return INPUT_INVALID;
+}
+
+/*
+ * Play a game between automatic players to the end, without any output
+ * Param: game - the game to play, started or loaded. game->turn - 1 tiles
+ *               have been placed once it returns
+ * Return: the winner, FIRST_PLAYER or SECOND_PLAYER
+ */
+int play_game(Game* game) {
+    while (!choose_move(game)) {
+        Player* player = &game->players[game->order];
+        play_move(game, player->rowStart, player->colStart,
+                player->validDegree);
+    }
+    return game->order ? FIRST_PLAYER : SECOND_PLAYER;
+}
+
+/*
+ * Load the board from the save file
+ * Param: board - the board to play on
+ *        file - the save file to get the board from
+ * Return: 1 if successfully loaded. Return 0 otherwise
+ */
+int load_board(Board* board, FILE* file) {
+    int row = 0, column = 0, next = 0;
+    next = fgetc(file);
+    while (next != EOF) {
+        column = 0;
+        while (next != '\n') {
+            if (row < board->height && column < board->width &&
+                    (next == FIRST_TYPE || next == SECOND_TYPE ||
+                    next == BOARD_EMPTY)) {
+                set_cell(board, row, column, (char) next);
+                column++;
+                next = fgetc(file);
+            } else {
+                return 0;
+            }
+        }
+        if (column != board->width) {
+            return 0;
+        }
+        row++;
+        next = fgetc(file);
+    }
+    if (row != board->height) {
+        return 0;
+    }
+    return 1;
+}
+
+/*
+ * Get a game whose board has been loaded from a save file ready to play
+ * Param: game - the game loaded
+ *        current - the next tile to play
+ *        order - the next player to have their turn
+ */
+void resume_game(Game* game, int current, int order) {
+    build_index(&game->board, &game->tiles);
+    game->tiles.current = current;
+    game->order = order;
+    set_start(&game->board, &game->players[FIRST_PLAYER]);
+    set_start(&game->board, &game->players[SECOND_PLAYER]);
+}
+
+/*
+ * Check the dimensions of a saved board, text or binary, can be played on
+ * Param: height, width - the dimensions read from the save; a negative one
+ *        from a text save converts to a value far too large
+ * Return: 1 if both are above 0 and below BOARD_LIMIT; 0 if not
+ */
+int save_dims(uint64_t height, uint64_t width) {
+    return 0 < height && height < BOARD_LIMIT && 0 < width &&
+            width < BOARD_LIMIT;
+}
+
+/*
+ * Copy the cells of a binary save into a new empty board
+ * Param: board - the board built for the save
+ *        cells - the cells of the save, laid out as described at SaveHeader
+ * Return: 1 if successfully loaded; 0 if a second player cell is empty
+ */
+int unpack_board(Board* board, uint64_t* cells) {
+    int words = (board->width + WORD_BITS - 1) / WORD_BITS;
+    for (int row = 0; row < board->height; row++) {
+        uint64_t* source = cells + (size_t) row * 2 * words;
+        for (int k = 0; k < words; k++) {
+            uint64_t bits = little_endian(source[k]) & word_mask(board, k);
+            uint64_t seconds = little_endian(source[words + k]) &
+                    word_mask(board, k);
+            if (seconds & ~bits) {
+                return 0;
+            }
+            change_cells(board, PLANE_OCCUPIED, row, k * WORD_BITS + MARGIN,
+                    bits, 1);
+            change_cells(board, PLANE_SECOND, row, k * WORD_BITS + MARGIN,
+                    seconds, 1);
+            for (; bits; bits &= bits - 1) {
+                board->hash ^= cell_key(row,
+                        k * WORD_BITS + __builtin_ctzll(bits));
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Copy the cells of a sparse binary save into a new empty board
+ * Param: board - the board built for the save
+ *        cells - the records of the save
+ *        count - the number of records
+ * Return: 1 if successfully loaded; 0 if a record is off the board, sets a
+ *         cell twice or has an empty second player cell
+ */
+int unpack_sparse(Board* board, SparseCells* cells, size_t count) {
+    uint64_t words = (board->width + WORD_BITS - 1) / WORD_BITS;
+    for (size_t n = 0; n < count; n++) {
+        uint64_t row = little_endian(cells[n].row);
+        uint64_t word = little_endian(cells[n].word);
+        if (row >= (uint64_t) board->height || word >= words) {
+            return 0;
+        }
+        int k = (int) word, bit = k * WORD_BITS + MARGIN;
+        uint64_t bits = little_endian(cells[n].occupied) & word_mask(board, k);
+        uint64_t seconds = little_endian(cells[n].second) &
+                word_mask(board, k);
+        if ((seconds & ~bits) ||
+                (read_cells(board, PLANE_OCCUPIED, (int) row, bit) & bits)) {
+            return 0;
+        }
+        change_cells(board, PLANE_OCCUPIED, (int) row, bit, bits, 1);
+        change_cells(board, PLANE_SECOND, (int) row, bit, seconds, 1);
+        for (; bits; bits &= bits - 1) {
+            board->hash ^= cell_key((int) row,
+                    k * WORD_BITS + __builtin_ctzll(bits));
+        }
+    }
+    return 1;
+}
+
+/*
+ * Load the game from a binary save file, mapped into memory rather than read
+ * Param: game - the game set up by init_game() to load into
+ *        file - the save file
+ * Return: ERROR_NONE, ERROR_ACCESS_SAVE if the save file can't be mapped, or
+ *         ERROR_SAVE_CONTENTS if its contents are invalid or it was saved
+ *         with other tiles
+ */
+int load_binary(Game* game, FILE* file) {
+    struct stat info;
+    if (fstat(fileno(file), &info) != 0 ||
+            info.st_size < (off_t) sizeof(SaveHeader)) {
+        return ERROR_SAVE_CONTENTS;
+    }
+    void* data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE,
+            fileno(file), 0);
+    if (data == MAP_FAILED) {
+        return ERROR_ACCESS_SAVE;
+    }
+    SaveHeader* header = (SaveHeader*) data;
+    int sparse = little_endian(header->magic) == SPARSE_MAGIC;
+    uint64_t size = (uint64_t) info.st_size - sizeof(SaveHeader);
+    uint64_t current = little_endian(header->tile);
+    uint64_t order = little_endian(header->player);
+    uint64_t height = little_endian(header->height);
+    uint64_t width = little_endian(header->width);
+    uint64_t words = (width + WORD_BITS - 1) / WORD_BITS;
+    int error = ERROR_SAVE_CONTENTS;
+    if (little_endian(header->checksum) == game->tiles.checksum &&
+            current < (uint64_t) game->tiles.size && order <= 1 &&
+            save_dims(height, width) && (sparse ?
+            size % sizeof(SparseCells) == 0 :
+            size == height * 2 * words * sizeof(uint64_t))) {
+        Board* board = &game->board;
+        board->height = (int) height;
+        board->width = (int) width;
+        new_board(board);
+        if (sparse ? unpack_sparse(board, (SparseCells*) (header + 1),
+                size / sizeof(SparseCells)) :
+                unpack_board(board, (uint64_t*) (header + 1))) {
+            error = ERROR_NONE;
+            resume_game(game, (int) current, (int) order);
+        }
+    }
+    munmap(data, info.st_size);
+    return error;
+}
+
+/*
+ * Load the game from the save file, text or binary
+ * Param: game - the game set up by init_game() to load into
+ *        path - the path of the save file
+ * Return: ERROR_NONE, ERROR_ACCESS_SAVE if the save file can't be read,
+ *         ERROR_SAVE_CONTENTS if its contents are invalid or
+ *         ERROR_END_INPUT if a text save ends within the first line
+ */
+int load_game(Game* game, char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return ERROR_ACCESS_SAVE;
+    }
+    uint64_t magic = 0;
+    if (fread(&magic, sizeof(magic), 1, file) == 1 &&
+            (little_endian(magic) == SAVE_MAGIC ||
+            little_endian(magic) == SPARSE_MAGIC)) {
+        int error = load_binary(game, file);
+        fclose(file);
+        return error;
+    }
+    rewind(file);
+    LineBuffer buffer = {NULL, 0};
+    char* firstLine = read_line(file, &buffer);
+    int num[4];
+    char next;
+    int status = firstLine == NULL ? EOF : sscanf(firstLine, "%d%d%d%d%c",
+            &num[0], &num[1], &num[2], &num[3], &next);
+    free(buffer.line);
+    int error = firstLine == NULL ? ERROR_END_INPUT : ERROR_SAVE_CONTENTS;
+    if (status == 4 && save_dims((uint64_t) num[2], (uint64_t) num[3])) {
+        int current = num[0], order = num[1];
+        Board* board = &game->board;
+        board->height = num[2];
+        board->width = num[3];
+        new_board(board);
+        if (current >= 0 && current < game->tiles.size &&
+                (order == 0 || order == 1) && load_board(board, file) == 1) {
+            error = ERROR_NONE;
+            resume_game(game, current, order);
+        }
+    }
+    fclose(file);
+    return error;
+}
+
+/*
+ * Work out the key of a snapshot, which the journal after it is tied to
+ * Param: game - the game as it was saved in the snapshot
+ * Return: the key
+ */
+uint64_t snapshot_key(Game* game) {
+    return mix_hash(game->board.hash ^ mix_hash((uint64_t) game->tiles.current
+            << 1 | (uint64_t) game->order));
+}
+
+/*
+ * Work out the check word of a journal record
+ * Param: key - the key of the journal
+ *        record - the record, with place and tile set
+ * Return: the check word
+ */
+uint64_t record_check(uint64_t key, JournalRecord* record) {
+    return mix_hash(key ^ mix_hash(record->place ^ mix_hash(record->tile)));
+}
+
+/*
+ * Write a file and make sure it has reached the disk before it is renamed
+ * over the one it replaces, so that a crash leaves the old file or the new
+ * one but never a torn one
+ * Param: path - the path the file is replacing
+ *        temporary - the path the file was written to
+ * Return: 1 if the file replaced the old one; 0 if not
+ */
+int replace_file(char* path, char* temporary) {
+    FILE* file = fopen(temporary, "r+");
+    int synced = file != NULL && fsync(fileno(file)) == 0;
+    if (file != NULL) {
+        fclose(file);
+    }
+    return synced && rename(temporary, path) == 0;
+}
+
+/*
+ * Fold the journal into a new snapshot of the game as it is now, and start
+ * an empty journal after it
+ * Param: journal - the journal, with its paths set
+ *        game - the game journaled
+ * Return: 1 if compacted; 0 if a file couldn't be written
+ */
+int compact_journal(Journal* journal, Game* game) {
+    size_t length = strlen(journal->path) + 5;
+    char* temporary = (char*) malloc(length);
+    int done = 0;
+    if (journal->file != NULL) {
+        fclose(journal->file);
+        journal->file = NULL;
+    }
+    snprintf(temporary, length, "%s.tmp", journal->snapshot);
+    if (save_binary(temporary, &game->tiles, game->order, &game->board) &&
+            replace_file(journal->snapshot, temporary)) {
+        // The snapshot is in place: the old journal is now stale
+        snprintf(temporary, length, "%s.tmp", journal->path);
+        FILE* file = fopen(temporary, "wb");
+        journal->key = snapshot_key(game);
+        JournalHeader header = {little_endian(JOURNAL_MAGIC),
+                little_endian(journal->key),
+                little_endian((uint64_t) game->turn)};
+        for (int i = 0; i < 2; i++) {
+            Player* player = &game->players[i];
+            header.starts[i] = little_endian((uint64_t) (uint32_t)
+                    player->rowStart | (uint64_t) (uint32_t)
+                    player->colStart << 32);
+        }
+        done = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1;
+        done = file != NULL && fclose(file) == 0 && done &&
+                replace_file(journal->path, temporary);
+    }
+    free(temporary);
+    journal->records = 0;
+    journal->file = done ? fopen(journal->path, "ab") : NULL;
+    journal->failed |= journal->file == NULL;
+    return journal->file != NULL;
+}
+
+/*
+ * Set the paths of a journal and clear the rest
+ * Param: journal - the journal to set up
+ *        base - the path of the snapshot and journal, without their suffixes
+ *        limit - records to keep before compacting into a new snapshot
+ */
+void init_journal(Journal* journal, char* base, long limit) {
+    size_t length = strlen(base) + strlen(SAVE_SUFFIX) + 1;
+    journal->snapshot = (char*) malloc(length);
+    journal->path = (char*) malloc(length);
+    snprintf(journal->snapshot, length, "%s%s", base, SAVE_SUFFIX);
+    snprintf(journal->path, length, "%s.fzj", base);
+    journal->file = NULL;
+    journal->key = 0;
+    journal->records = 0;
+    journal->limit = limit;
+    journal->failed = 0;
+}
+
+/*
+ * Start journaling a game: snapshot it as it is and start an empty journal
+ * Param: journal - the journal to open
+ *        game - the game started or loaded; its moves are journaled from now
+ *        base - the path of the snapshot and journal, without their suffixes
+ *        limit - records to keep before compacting into a new snapshot
+ * Return: ERROR_NONE, or ERROR_ACCESS_SAVE if the files can't be written
+ */
+int open_journal(Journal* journal, Game* game, char* base, long limit) {
+    init_journal(journal, base, limit);
+    if (!compact_journal(journal, game)) {
+        close_journal(journal);
+        return ERROR_ACCESS_SAVE;
+    }
+    game->journal = journal;
+    return ERROR_NONE;
+}
+
+/*
+ * Replay the records of a journal which are intact and follow on from the
+ * game, stopping at the first which is torn or doesn't
+ * Param: journal - the journal, with its key set
+ *        game - the game loaded from the snapshot
+ *        file - the journal, after its header
+ */
+void replay_journal(Journal* journal, Game* game, FILE* file) {
+    JournalRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+        record.place = little_endian(record.place);
+        record.tile = little_endian(record.tile);
+        int row = (int32_t) (record.place & 0xFFFFFFFF);
+        int column = (int32_t) (record.place >> 32);
+        int tile = (int32_t) (record.tile & 0xFFFFFFFF);
+        uint64_t rotation = record.tile >> 32;
+        Tile* current = &game->tiles.allTiles[game->tiles.current];
+        if (little_endian(record.check) != record_check(journal->key,
+                &record) || tile != game->tiles.current || rotation > 3 ||
+                !valid_place(rotate_tile((int) rotation * 90, current),
+                &game->board, row, column)) {
+            return;
+        }
+        play_move(game, row, column, (int) rotation * 90);
+    }
+}
+
+/*
+ * Recover a journaled game: load its snapshot, replay the journal on top,
+ * fold both into a new snapshot and carry on journaling
+ * Param: game - the game set up by init_game() to recover into
+ *        journal - the journal to open
+ *        base - the path of the snapshot and journal, without their suffixes
+ *        limit - records to keep before compacting into a new snapshot
+ * Return: ERROR_NONE, an error of load_game() for the snapshot, or
+ *         ERROR_ACCESS_SAVE if the files can't be written
+ */
+int recover_game(Game* game, Journal* journal, char* base, long limit) {
+    init_journal(journal, base, limit);
+    int error = load_game(game, journal->snapshot);
+    FILE* file = error == ERROR_NONE ? fopen(journal->path, "rb") : NULL;
+    JournalHeader header;
+    journal->key = error == ERROR_NONE ? snapshot_key(game) : 0;
+    if (file != NULL && fread(&header, sizeof(header), 1, file) == 1 &&
+            little_endian(header.magic) == JOURNAL_MAGIC &&
+            little_endian(header.key) == journal->key) {
+        game->turn = (int) little_endian(header.turn);
+        for (int i = 0; i < 2; i++) {
+            uint64_t start = little_endian(header.starts[i]);
+            game->players[i].rowStart = (int32_t) (start & 0xFFFFFFFF);
+            game->players[i].colStart = (int32_t) (start >> 32);
+        }
+        replay_journal(journal, game, file);
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+    if (error == ERROR_NONE && !compact_journal(journal, game)) {
+        error = ERROR_ACCESS_SAVE;
+    }
+    if (error != ERROR_NONE) {
+        close_journal(journal);
+        return error;
+    }
+    game->journal = journal;
+    return ERROR_NONE;
+}
+
+/*
+ * Append a move to the journal, compacting it into a new snapshot once it
+ * holds its limit of records. Each record is flushed as it is written.
+ * Param: journal - the journal
+ *        game - the game, with the move played
+ *        tile - the tile played
+ *        row, column - where the middle of the tile went
+ *        degrees - how far the tile was rotated
+ */
+void journal_move(Journal* journal, Game* game, int tile, int row, int column,
+        int degrees) {
+    if (journal->file == NULL) {
+        return;
+    }
+    if (journal->records >= journal->limit) {
+        compact_journal(journal, game);
+        return;
+    }
+    JournalRecord record;
+    record.place = (uint64_t) (uint32_t) row | (uint64_t) (uint32_t) column
+            << 32;
+    record.tile = (uint64_t) (uint32_t) tile | (uint64_t) (degrees / 90) << 32;
+    record.check = little_endian(record_check(journal->key, &record));
+    record.place = little_endian(record.place);
+    record.tile = little_endian(record.tile);
+    journal->failed |= fwrite(&record, sizeof(record), 1, journal->file) != 1 ||
+            fflush(journal->file) != 0;
+    journal->records++;
+}
+
+/*
+ * Close a journal, leaving its files for recover_game()
+ * Param: journal - the journal to close
+ */
+void close_journal(Journal* journal) {
+    if (journal->file != NULL) {
+        fclose(journal->file);
+    }
+    free(journal->snapshot);
+    free(journal->path);
+    journal->file = NULL;
+    journal->snapshot = journal->path = NULL;
+}
+
+/*
+ * Work out how a game record packs the moves on a board: a move is its
+ * rotation in 2 bits, then its anchor column + MIDDLE and row + MIDDLE in
+ * as few bits as hold any of them
+ * Param: height, width - the size of the board
+ *        columnBits - set to the bits of the column
+ * Return: the bits of a move
+ */
+int record_bits(int height, int width, int* columnBits) {
+    *columnBits = WORD_BITS - __builtin_clzll(width + 2 * MIDDLE - 1);
+    return 2 + *columnBits + WORD_BITS - __builtin_clzll(height + 2 * MIDDLE -
+            1);
+}
+
+/*
+ * Append a record of a game started on an empty board to a record file, laid
+ * out as described at RecordHeader, in one write so that games finishing at
+ * once can share a file
+ * Param: game - the game, with the moves played since it started
+ *        path - the record file
+ * Return: 1 if the record was written; 0 if not
+ */
+int record_game(Game* game, char* path) {
+    History* history = &game->history;
+    int columnBits, bits = record_bits(game->board.height, game->board.width,
+            &columnBits);
+    size_t words = sizeof(RecordHeader) / sizeof(uint64_t) +
+            ((size_t) history->count * bits + WORD_BITS - 1) / WORD_BITS;
+    // One word spare, as a move may run into the word after the last
+    uint64_t* data = (uint64_t*) calloc(words + 1, sizeof(uint64_t));
+    RecordHeader* header = (RecordHeader*) data;
+    uint64_t* packed = data + sizeof(RecordHeader) / sizeof(uint64_t);
+    header->magic = RECORD_MAGIC;
+    header->checksum = game->tiles.checksum;
+    header->height = (uint64_t) game->board.height;
+    header->width = (uint64_t) game->board.width;
+    header->start = (uint64_t) (history->count ? history->moves[0].tile :
+            game->tiles.current) | (uint64_t) (game->order ^
+            (history->count & 1)) << 32;
+    header->moves = (uint64_t) history->count;
+    for (int n = 0; n < history->count; n++) {
+        Played* played = &history->moves[n];
+        uint64_t move = (uint64_t) (played->degrees / 90) |
+                (uint64_t) (played->column + MIDDLE) << 2 |
+                (uint64_t) (played->row + MIDDLE) << (2 + columnBits);
+        size_t bit = (size_t) n * bits;
+        packed[bit / WORD_BITS] |= move << bit % WORD_BITS;
+        if (bit % WORD_BITS + bits > WORD_BITS) {
+            packed[bit / WORD_BITS + 1] |= move >> (WORD_BITS -
+                    bit % WORD_BITS);
+        }
+    }
+    for (size_t k = 0; k < words; k++) {
+        data[k] = little_endian(data[k]);
+    }
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0666);
+    size_t size = words * sizeof(uint64_t);
+    int done = fd >= 0 && write(fd, data, size) == (ssize_t) size;
+    done = fd >= 0 && close(fd) == 0 && done;
+    free(data);
+    return done;
+}
+
+/*
+ * Read the game record at the start of some bytes of a record file
+ * Param: data - the bytes, 8-byte aligned
+ *        size - the number of bytes
+ *        tiles - the tiles the record has to have been played with
+ *        record - where to store the record, which refers into data
+ * Return: ERROR_NONE, or ERROR_RECORD_CONTENTS if there is no whole record
+ *         of those tiles
+ */
+int read_record(const void* data, size_t size, AllTiles* tiles,
+        Record* record) {
+    const uint64_t* words = (const uint64_t*) data;
+    if (size < sizeof(RecordHeader) || little_endian(words[0]) !=
+            RECORD_MAGIC || little_endian(words[1]) != tiles->checksum) {
+        return ERROR_RECORD_CONTENTS;
+    }
+    uint64_t height = little_endian(words[2]), width = little_endian(words[3]);
+    uint64_t start = little_endian(words[4]), moves = little_endian(words[5]);
+    if (height == 0 || height >= BOARD_LIMIT || width == 0 ||
+            width >= BOARD_LIMIT || (start & 0xFFFFFFFF) >=
+            (uint64_t) tiles->size || start >> 32 > 1 ||
+            moves > (size - sizeof(RecordHeader)) * 8) {
+        return ERROR_RECORD_CONTENTS;
+    }
+    int columnBits, bits = record_bits((int) height, (int) width, &columnBits);
+    size_t length = sizeof(RecordHeader) + sizeof(uint64_t) *
+            ((moves * bits + WORD_BITS - 1) / WORD_BITS);
+    if (length > size) {
+        return ERROR_RECORD_CONTENTS;
+    }
+    record->height = (int) height;
+    record->width = (int) width;
+    record->tile = (int) (start & 0xFFFFFFFF);
+    record->order = (int) (start >> 32);
+    record->moves = (long) moves;
+    record->packed = words + sizeof(RecordHeader) / sizeof(uint64_t);
+    record->size = length;
+    return ERROR_NONE;
+}
+
+/*
+ * Play the moves of a game record onto a board with put_tile(), checking
+ * each with valid_place() but keeping nothing else
+ * Param: record - the record
+ *        tiles - the tiles it was played with
+ *        board - an empty board of the record's size
+ *        moves - the moves to play; all of them if the record has fewer
+ * Return: the moves played, fewer than asked for if one doesn't fit
+ */
+long replay_record(Record* record, AllTiles* tiles, Board* board,
+        long moves) {
+    int columnBits, bits = record_bits(record->height, record->width,
+            &columnBits);
+    uint64_t mask = ((uint64_t) 1 << bits) - 1;
+    uint64_t columnMask = ((uint64_t) 1 << columnBits) - 1;
+    int tile = record->tile, order = record->order;
+    moves = moves < record->moves ? moves : record->moves;
+    for (long n = 0; n < moves; n++) {
+        size_t bit = (size_t) n * bits;
+        uint64_t move = little_endian(record->packed[bit / WORD_BITS]) >>
+                bit % WORD_BITS;
+        if (bit % WORD_BITS + bits > WORD_BITS) {
+            move |= little_endian(record->packed[bit / WORD_BITS + 1]) <<
+                    (WORD_BITS - bit % WORD_BITS);
+        }
+        move &= mask;
+        int row = (int) (move >> (2 + columnBits)) - MIDDLE;
+        int column = (int) (move >> 2 & columnMask) - MIDDLE;
+        uint8_t* rotation = tiles->allTiles[tile].rotations[move & 3];
+        if (!valid_place(rotation, board, row, column)) {
+            return n;
+        }
+        put_tile(rotation, board, row, column,
+                order ? SECOND_TYPE : FIRST_TYPE);
+        tile = tile + 1 < tiles->size ? tile + 1 : 0;
+        order = !order;
+    }
+    return moves;
+}
+
+/*
+ * Take back the last move played: take its tile off the board and put the
+ * current tile, the turn, the player to move and the mover's last move back
+ * as they were. A journaled game is compacted so the journal forgets it.
+ * Param: game - the game to take the move back in
+ * Return: 1 if a move was taken back; 0 if none has been played since the
+ *         game was started or loaded
+ */
+int undo_move(Game* game) {
+    History* history = &game->history;
+    if (history->count == 0) {
+        return 0;
+    }
+    Played* played = &history->moves[--history->count];
+    game->order = game->order ? FIRST_PLAYER : SECOND_PLAYER;
+    game->turn--;
+    game->tiles.current = played->tile;
+    take_tile(rotate_tile(played->degrees,
+            &game->tiles.allTiles[played->tile]), &game->board, played->row,
+            played->column);
+    Player* player = &game->players[game->order];
+    player->rowStart = played->rowStart;
+    player->colStart = played->colStart;
+    player->validDegree = played->validDegree;
+    if (game->journal != NULL && game->journal->file != NULL) {
+        compact_journal(game->journal, game);
+    }
+    return 1;
+}
+
+/*
+ * Take back the last move of the player to move and the other player's move
+ * since, so that the player moves again
+ * Param: game - the game to take the moves back in
+ * Return: 1 if the moves were taken back; 0 if the player to move hasn't
+ *         moved since the game was started or loaded
+ */
+int undo_turn(Game* game) {
+    if (game->history.count < 2) {
+        return 0;
+    }
+    undo_move(game);
+    undo_move(game);
+    return 1;
+}
+
+/*
+ * Play a list of moves on from the game as it is, checking that each is
+ * legal. Taking the moves back with undo_move() and replaying them again
+ * costs only the cells of the tiles.
+ * Param: game - the game to play the moves in
+ *        moves - the moves, each with the current tile in turn
+ *        count - the number of moves
+ * Return: the number of moves played, less than count if one was illegal
+ */
+int replay_moves(Game* game, Move* moves, int count) {
+    for (int i = 0; i < count; i++) {
+        Move* move = &moves[i];
+        Tile* tile = &game->tiles.allTiles[game->tiles.current];
+        if (move->rotation < 0 || move->rotation > 3 ||
+                !valid_place(tile->rotations[move->rotation], &game->board,
+                move->row, move->column)) {
+            return i;
+        }
+        play_move(game, move->row, move->column, move->rotation * 90);
+    }
+    return count;
+}
+
+/*
+ * Read the budget of an MCTS or search player type: nothing for the
+ * standard budget, ":N" for N playouts or positions, or ":Nms" for N
+ * milliseconds per move
+ * Param: budget - the type after its letter
+ *        standard - the budget if none is given
+ *        player - the player to set the budget of
+ * Return: 1 if the budget is valid; 0 if it is not
+ */
+int check_budget(char* budget, long standard, Player* player) {
+    char units[3] = "";
+    char next;
+    player->budget = standard;
+    player->timed = 0;
+    if (budget[0] == '\0') {
+        return 1;
+    }
+    int status = sscanf(budget, ":%ld%2s%c", &player->budget, units, &next);
+    if (status < 1 || status > 2 || player->budget <= 0 ||
+            (status == 2 && strcmp(units, "ms") != 0) || budget[1] == ' ' ||
+            budget[1] == '+' || budget[1] == '-') {
+        return 0;
+    }
+    player->timed = status == 2;
+    return 1;
+}
+
+/*
+ * Check and decide the player type
+ * Param: type - the type got from the command line
+ *        player - whose type needs to be defined
+ * Return: ERROR_NONE, or ERROR_PLAYER if the type is invalid i.e. not 'h',
+ *         '1', '2', 'e', nor 's' or 'm' with an optional budget. The player
+ *         can be freed by free_player() either way.
+ */
+int check_player(char* type, Player* player) {
+    player->input.line = NULL;
+    player->input.max = 0;
+    player->search = NULL;
+    player->report = NULL;
+    player->threads = 0;
+    player->pool = NULL;
+    if (strcmp(type, "h") == 0) {
+        player->type = HUMAN;
+    } else if (strcmp(type, "1") == 0) {
+        player->type = AUTO_1;
+    } else if (strcmp(type, "2") == 0) {
+        player->type = AUTO_2;
+    } else if (type[0] == 's' && check_budget(type + 1, SEARCH_NODES,
+            player)) {
+        player->type = SEARCH;
+        player->search = new_search();
+    } else if (strcmp(type, "e") == 0) {
+        player->type = ENDGAME;
+        player->search = new_search();
+        player->budget = SEARCH_NODES;
+        player->timed = 0;
+    } else if (type[0] == 'm' && check_budget(type + 1, MCTS_PLAYOUTS,
+            player)) {
+        player->type = MCTS;
+    } else {
+        return ERROR_PLAYER;
+    }
+    return ERROR_NONE;
+}
+
+/*
+ * Free what a player allocated
+ * Param: player - the player to free the input buffer and search state of
+ */
+void free_player(Player* player) {
+    free(player->input.line);
+    free_search(player->search);
+    free_scan_pool(player->pool);
+}
+
+/*
+ * Set up a game between two players, to be started or loaded next
+ * Param: game - the game to set up
+ *        tiles - collection of all tiles, shared read-only with other games
+ *        type1 - the type of the first player
+ *        type2 - the type of the second player
+ * Return: ERROR_NONE, or ERROR_PLAYER if a type is invalid. Nothing is left
+ *         to free then.
+ */
+int init_game(Game* game, AllTiles* tiles, char* type1, char* type2) {
+    game->tiles = *tiles;
+    game->tiles.current = 0;
+    game->board.occupied = NULL;
+    game->board.chunks = NULL;
+    game->board.index = NULL;
+    game->order = FIRST_PLAYER;
+    game->turn = 1;
+    game->journal = NULL;
+    game->history.moves = NULL;
+    game->history.count = game->history.max = 0;
+    int error = check_player(type1, &game->players[FIRST_PLAYER]);
+    if (error == ERROR_NONE) {
+        error = check_player(type2, &game->players[SECOND_PLAYER]);
+        if (error != ERROR_NONE) {
+            free_player(&game->players[FIRST_PLAYER]);
+        }
+    }
+    game->players[FIRST_PLAYER].order = FIRST_PLAYER;
+    game->players[SECOND_PLAYER].order = SECOND_PLAYER;
+    return error;
+}
+
+/*
+ * Start a new game on an empty board
+ * Param: game - the game set up by init_game() to start
+ *        height, width - the size of the board
+ * Return: ERROR_NONE, or ERROR_DIMS if the size isn't between 1 and
+ *         BOARD_LIMIT - 1
+ */
+int start_game(Game* game, int height, int width) {
+    if (height <= 0 || height >= BOARD_LIMIT || width <= 0 ||
+            width >= BOARD_LIMIT) {
+        return ERROR_DIMS;
+    }
+    game->board.height = height;
+    game->board.width = width;
+    new_board(&game->board);
+    build_index(&game->board, &game->tiles);
+    set_start(&game->board, &game->players[FIRST_PLAYER]);
+    set_start(&game->board, &game->players[SECOND_PLAYER]);
+    return ERROR_NONE;
+}
+
+/*
+ * Free what a game allocated, leaving the shared tiles alone
+ * Param: game - the game to free
+ */
+void free_game(Game* game) {
+    free_board(&game->board);
+    free(game->history.moves);
+    free_player(&game->players[FIRST_PLAYER]);
+    free_player(&game->players[SECOND_PLAYER]);
+}
+
+/*
+ * Free the dynamic array built in Tile and AllTiles
+ * Param: tiles - the collection of all tiles
+ */
+void free_tiles(AllTiles* tiles) {
+    free(tiles->allTiles);
+}
+
+/*
+ * Describe an error
+ * Param: error - the error code
+ * Return: the message for the error
+ */
+char* error_message(int error) {
+    switch (error) {
+        case ERROR_NONE:
+            return "No error";
+        case ERROR_ARG:
+            return "Invalid arguments";
+        case ERROR_ACCESS_TILE:
+            return "Can't access tile file";
+        case ERROR_TILE_CONTENTS:
+            return "Invalid tile file contents";
+        case ERROR_PLAYER:
+            return "Invalid player type";
+        case ERROR_DIMS:
+            return "Invalid dimensions";
+        case ERROR_ACCESS_SAVE:
+            return "Can't access save file";
+        case ERROR_SAVE_CONTENTS:
+            return "Invalid save file contents";
+        case ERROR_ACCESS_RECORD:
+            return "Can't access record file";
+        case ERROR_RECORD_CONTENTS:
+            return "Invalid record file contents";
+        case ERROR_END_INPUT:
+            return "End of input";
+        default:
+            return "Unknown error";
+    }
+}
@@ -1,745 +1,1494 @@
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "fitz.h"
 
-/* Exit status */
-#define EXIT_ARG 1
-#define EXIT_ACCESS_TILE 2
-#define EXIT_TILE_CONTENTS 3
-#define EXIT_PLAYER 4
-#define EXIT_DIMS 5
-#define EXIT_ACCESS_SAVE 6
-#define EXIT_SAVE_CONTENTS 7
-#define EXIT_END_INPUT 10
-
-#define MIDDLE 2 // The middle (@) of the 2D array tile is at tile[2][2]
-#define TILE_SIZE 5 // Tile size: each tile is described as a 5*5 grid.
-#define MAX 70 // Initial size of a dynamic char array
-#define AUTO_1 1
-#define AUTO_2 2
-#define HUMAN 3
-#define FIRST_TYPE '*'
-#define SECOND_TYPE '#'
-#define BOARD_EMPTY '.'
-#define TILE_EMPTY ','
-#define TILE_EXIST '!'
-#define FIRST_PLAYER 0
-#define SECOND_PLAYER 1
-
-/* A tile with its rotations */
+#define OUTPUT_BOARD 0 // Print the board after every turn
+#define OUTPUT_CELLS 1 // Print only the cells each turn fills
+#define OUTPUT_MOVES 2 // Print only the moves
+#define JOURNAL_LIMIT 4096 // Moves journaled before compacting the journal
+#define SOLVE_NODES 10000000 // Most positions --solve visits
+#define PHASE_CHOOSE 0 // Turn phases timed for --stats: picking a move,
+#define PHASE_PLACE 1 // putting the tile,
+#define PHASE_PRINT 2 // printing the board or what the turn did,
+#define PHASE_INPUT 3 // and reading and playing a human's input
+#define PHASE_COUNT 4
+#define SESSION_NEW 0 // Server sessions: waiting for the line starting a game,
+#define SESSION_INPUT 1 // waiting for a human player's line,
+#define SESSION_BUSY 2 // with a worker playing turns,
+#define SESSION_OVER 3 // or closing once the rest of the reply is written
+#define SERVER_EVENTS 64 // Events the server takes from epoll at a time
+#define READ_CHUNK 4096 // Bytes read from a session at a time
+#define REPLAY_BLOCK 256 // Records a replay thread takes at a time
+#ifndef FITZ_MAIN
+#define FITZ_MAIN main // Each tile size's build is one fitz_main_N() of fitz
+#endif
+#ifdef FITZ_STATS
+#define STATS_ONLY(...) __VA_ARGS__
+#define TIMED(seconds, phase, ...) do { \
+        double phaseStart = now_seconds(); \
+        __VA_ARGS__; \
+        seconds[phase] += now_seconds() - phaseStart; \
+    } while (0)
+#else
+#define STATS_ONLY(...)
+#define TIMED(seconds, phase, ...) __VA_ARGS__
+#endif
+
+/* One game of a tournament */
 typedef struct {
-    char** rotate0;
-    char** rotate90;
-    char** rotate180;
-    char** rotate270;
-} Tile;
+    char* types[2]; // The player types, first player first
+    int height;
+    int width;
+    int start; // The first tile to play
+    int winner; // FIRST_PLAYER or SECOND_PLAYER, once played
+    int turns; // Tiles placed, once played
+} Match;
 
-/* Collection of all tiles */
+/* The games a tournament thread has left; other threads steal from the end */
 typedef struct {
-    int size; // Total number of tiles
-    int current; // Current tile (starting at 0)
-    Tile* allTiles;
-} AllTiles;
+    pthread_mutex_t lock;
+    int next; // First game left
+    int end; // One past the last game left
+} MatchQueue;
 
-/* The board to place tiles on */
+/* A tournament being played */
 typedef struct {
-    int height;
-    int width;
-    char** grid;
-} Board;
+    AllTiles* tiles; // Shared by all games
+    Match* matches;
+    MatchQueue* queues; // One per thread
+    int threads;
+} Tournament;
+
+/* One thread playing tournament games */
+typedef struct {
+    Tournament* tournament;
+    int id; // Which queue is its own
+    pthread_t thread;
+} TournamentWorker;
 
-/* Player h, 1, or 2*/
+/* Save files being analysed, taken one at a time by the analysis threads */
 typedef struct {
-    int rowStart;
-    int colStart;
-    int validDegree;
-    int type; // AUTO_1 (1), AUTO_2 (2), or HUMAN (3)
-    int order; // FIRST_PLAYER (0) or SECOND_PLAYER (1)
-} Player;
+    AllTiles* tiles; // Shared by all games
+    char** paths;
+    char** lines; // The analysis of each, once done
+    int count;
+    int next; // The next file to take
+    pthread_mutex_t lock;
+} Analyses;
+
+/* A game played over one connection to the server */
+typedef struct Session {
+    int fd;
+    int state; // SESSION_NEW, SESSION_INPUT, SESSION_BUSY or SESSION_OVER
+    int after; // The state a worker leaves the session in
+    int started; // Whether the game is set up and has to be freed
+    int ended; // Whether the client has sent all it is going to
+    int failed; // Whether writing to the client failed
+    int watched; // The epoll events asked for; 0 when the fd isn't added
+    int output; // OUTPUT_BOARD, OUTPUT_CELLS or OUTPUT_MOVES
+    Game game;
+    char* in; // Bytes read and not yet taken as lines
+    size_t inLength;
+    size_t inMax;
+    char* out; // Bytes not yet written, from outStart on
+    size_t outStart;
+    size_t outLength;
+    char* line; // The line a worker is to play next
+    char* reply; // What the worker printed playing it
+    size_t replyLength;
+    struct Session* next; // In the queue for the workers or the finished
+} Session;
+
+/* The server: sessions wait in a queue for a worker to play their turns */
+typedef struct {
+    AllTiles* tiles; // Shared by all sessions
+    int epoll;
+    int listener;
+    int wake; // An eventfd the workers signal when they finish a session
+    pthread_mutex_t lock;
+    pthread_cond_t ready; // Signalled when a session is queued
+    Session* first; // The queue, oldest first
+    Session* last;
+    Session* finished; // Sessions the workers are done with
+    Session* closed; // Sessions to free once the events in hand are handled
+} Server;
+
+/* Game records being replayed, taken a block at a time by the threads */
+typedef struct {
+    AllTiles* tiles; // Shared by all threads
+    Record* records; // The records of every file, in order
+    long count;
+    long next; // The first record not yet taken
+    long moves; // Moves replayed, added up as the threads finish
+    long invalid; // Records with a move that doesn't fit
+    pthread_mutex_t lock;
+} Replays;
+
+/*
+ * Print the message of an error and exit with it, if there is one
+ * Param: error - the error code returned by the engine
+ */
+void check_error(int error) {
+    if (error != ERROR_NONE) {
+        fprintf(stderr, "%s\n", error_message(error));
+        exit(error);
+    }
+}
 
 /*
- * Rotate a tile clockwise in 90 degrees.
- * Param: original - the non-rotated tile
- * Return: the rotated tile
+ * Get the user input from the human player until they move or take back
+ * their last move
+ * Param: game - the game the human player is to move in
+ * Return: INPUT_MOVED or INPUT_UNDONE
+ * Error: exit at status 10 if the input ends
  */
-char** rotate_once(char** original) {
-    char** result = (char**) malloc(sizeof(char*) * TILE_SIZE);
-    for (int row = 0; row < TILE_SIZE; row++) {
-        result[row] = (char*) malloc(sizeof(char) * TILE_SIZE);
-        for (int column = 0; column < TILE_SIZE; column++) {
-            result[row][column] = original[TILE_SIZE - 1 - column][row];
+int human_turn(Game* game) {
+    Player* player = &game->players[game->order];
+    char type = player->order ? SECOND_TYPE : FIRST_TYPE;
+    int result = INPUT_INVALID;
+    while (result != INPUT_MOVED && result != INPUT_UNDONE) {
+        // Keep prompting until the input is valid
+        printf("Player %c] ", type);
+        char* line = read_line(stdin, &player->input);
+        if (line == NULL) {
+            check_error(ERROR_END_INPUT);
+        }
+        result = play_input(game, line);
+        if (result == INPUT_UNSAVED) {
+            fprintf(stderr, "Unable to save game\n");
         }
     }
     return result;
 }
 
 /*
- * Rotate the tile in all three degrees and save the rotations
- * Param: tile - the tile to rotate
+ * Write one turn's line of the --stats stream, with the engine's hot-path
+ * counts since the last one, and start timing the next turn
+ * Param: stats - the stream, or NULL if the stats weren't asked for
+ *        seconds - the time the turn took in each phase, zeroed after
+ *        turn - the turn, counting from 1
+ *        type - FIRST_TYPE or SECOND_TYPE, whose turn it was
+ *        result - "moved", "undone" or "lost"
  */
-void set_rotate(Tile* tile) {
-    tile->rotate90 = rotate_once(tile->rotate0);
-    tile->rotate180 = rotate_once(tile->rotate90);
-    tile->rotate270 = rotate_once(tile->rotate180);
+void print_stats(FILE* stats, double* seconds, int turn, char type,
+        char* result) {
+    long counts[STAT_COUNT];
+    take_stats(counts);
+    if (stats != NULL) {
+        fprintf(stats, "{\"turn\":%d,\"player\":\"%c\",\"result\":\"%s\","
+                "\"choose_s\":%.9f,\"place_s\":%.9f,\"print_s\":%.9f,"
+                "\"input_s\":%.9f,\"anchors\":%ld,\"rotations\":%ld,"
+                "\"valid_place\":%ld,\"off_board\":%ld,\"overlap\":%ld}\n",
+                turn, type, result, seconds[PHASE_CHOOSE],
+                seconds[PHASE_PLACE], seconds[PHASE_PRINT],
+                seconds[PHASE_INPUT], counts[STAT_ANCHORS],
+                counts[STAT_ROTATIONS], counts[STAT_VALID],
+                counts[STAT_OFF_BOARD], counts[STAT_OVERLAP]);
+        fflush(stats);
+    }
+    memset(seconds, 0, sizeof(double) * PHASE_COUNT);
 }
 
 /*
- * Called by read_file(). Print error message and exit at status 3.
+ * Print what a turn did as the output mode asks: the board after it, the
+ * cells it filled or nothing
+ * Param: out - the stream to print to
+ *        output - OUTPUT_BOARD, OUTPUT_CELLS or OUTPUT_MOVES
+ *        game - the game, after the turn
+ *        tile - the tile placed
+ *        type - FIRST_TYPE or SECOND_TYPE, whose turn it was
  */
-void invalid_file(void) {
-    fprintf(stderr, "Invalid tile file contents\n");
-    exit(EXIT_TILE_CONTENTS);
+void print_turn(FILE* out, int output, Game* game, Tile* tile, char type) {
+    Player* player = &game->players[type == SECOND_TYPE ? SECOND_PLAYER :
+            FIRST_PLAYER];
+    if (output == OUTPUT_BOARD) {
+        print_board(out, &game->board);
+    } else if (output == OUTPUT_CELLS) {
+        print_cells(out, rotate_tile(player->validDegree, tile),
+                player->rowStart, player->colStart, type);
+    }
 }
 
-/**
- * Read the tile file.
- * Param: file - the tile file
- *        tiles - the collection to store all tiles
- * Error: call invalid_file() if the tile file is incorrect
+/*
+ * Play a game to the end, printing the board at the start and after every
+ * turn, or what the output mode asks for instead
+ * Param: game - the game to play, started or loaded
+ *        output - OUTPUT_BOARD, OUTPUT_CELLS or OUTPUT_MOVES
+ *        stats - where to write a line of stats each turn, or NULL. Builds
+ *                without FITZ_STATS time nothing and never write them.
+ *        record - the record file to append the game to when it ends, or
+ *                 NULL. The game must have started on an empty board.
  */
-void read_file(FILE* file, AllTiles* tiles) {
-    tiles->allTiles = (Tile*) malloc(sizeof(Tile) * 1);
-    int row = 0, column = 0, next = 0;
-    tiles->size = 0;
-    Tile* tile;
+void new_game(Game* game, int output, FILE* stats, char* record) {
+    STATS_ONLY(double seconds[PHASE_COUNT] = {0};)
+    TIMED(seconds, PHASE_PRINT, print_board(stdout, &game->board));
     while (1) {
-        tiles->allTiles[tiles->size].rotate0 =
-                (char**) malloc(sizeof(char*) * TILE_SIZE);
-        tile = &(tiles->allTiles[tiles->size]);
-        while (row < TILE_SIZE) {
-            tile->rotate0[row] = (char*) malloc(sizeof(char) * TILE_SIZE);
-            for (column = 0; column < 6; column++) {
-                next = fgetc(file);
-                if (column == TILE_SIZE && next == '\n') {
-                    row++;
-                } else if (column < TILE_SIZE && (next == TILE_EMPTY ||
-                        next == TILE_EXIST)) {
-                    tile->rotate0[row][column] = (char) next;
-                } else {
-                    invalid_file();
-                }
+        Player* player = &game->players[game->order];
+        char type = game->order ? SECOND_TYPE : FIRST_TYPE;
+        Tile* tile = &(game->tiles.allTiles[game->tiles.current]);
+        int end, result = INPUT_MOVED;
+        TIMED(seconds, PHASE_CHOOSE, end = choose_move(game));
+        if (end) {
+            char preType = game->order ? FIRST_TYPE : SECOND_TYPE;
+            STATS_ONLY(print_stats(stats, seconds, game->turn, type, "lost"));
+            printf("Player %c wins\n", preType);
+            if (record != NULL && !record_game(game, record)) {
+                fprintf(stderr, "Unable to write record\n");
             }
-        }
-        set_rotate(tile);
-        row = 0;
-        next = fgetc(file);
-        tiles->size++;
-        if (next == EOF) {
             return;
-        } else if (next == '\n') {
-            tiles->allTiles = (Tile*) realloc(tiles->allTiles,
-                    sizeof(Tile) * (tiles->size + 1));
+        }
+        if (player->type == HUMAN) {
+            print_tile(stdout, tile, 0);
+            TIMED(seconds, PHASE_INPUT, result = human_turn(game));
+            if (result == INPUT_UNDONE) {
+                // The player moves again from the position taken back to
+                TIMED(seconds, PHASE_PRINT,
+                        print_board(stdout, &game->board));
+                STATS_ONLY(print_stats(stats, seconds, game->turn, type,
+                        "undone"));
+                continue;
+            }
         } else {
-            invalid_file();
+            // The game continues. Put the valid tile
+            printf("Player %c => %d %d rotated %d\n", type, player->rowStart,
+                    player->colStart, player->validDegree);
+            TIMED(seconds, PHASE_PLACE, play_move(game, player->rowStart,
+                    player->colStart, player->validDegree));
         }
+        TIMED(seconds, PHASE_PRINT, print_turn(stdout, output, game, tile,
+                type));
+        STATS_ONLY(print_stats(stats, seconds, game->turn - 1, type,
+                "moved"));
     }
 }
 
 /*
- * Print a tile.
- * Param: tile - the tile to print
- *        all - if all is 1, print all rotations. Otherwise just the original
+ * Play one game of a tournament
+ * Param: tiles - collection of all tiles, shared with the other games
+ *        match - the game to play; its result is stored in it
  */
-void print_tile(Tile* tile, int all) {
-    for (int row = 0; row < TILE_SIZE; row++) {
-        printf("%s", tile->rotate0[row]);
-        if (all) {
-            printf(" %s", tile->rotate90[row]);
-            printf(" %s", tile->rotate180[row]);
-            printf(" %s", tile->rotate270[row]);
+void play_match(AllTiles* tiles, Match* match) {
+    Game game;
+    init_game(&game, tiles, match->types[0], match->types[1]);
+    // The tournament already keeps every core busy
+    game.players[0].threads = game.players[1].threads = 1;
+    game.tiles.current = match->start;
+    start_game(&game, match->height, match->width);
+    match->winner = play_game(&game);
+    match->turns = game.turn - 1;
+    free_game(&game);
+}
+
+/*
+ * Take the next game for a tournament thread to play: the next one of its
+ * own, or else the later half of what another thread has left
+ * Param: tournament - the tournament
+ *        id - the thread taking a game
+ * Return: the game, or -1 if all games have been taken
+ */
+int take_match(Tournament* tournament, int id) {
+    MatchQueue* own = &tournament->queues[id];
+    pthread_mutex_lock(&own->lock);
+    int match = own->next < own->end ? own->next++ : -1;
+    pthread_mutex_unlock(&own->lock);
+    for (int n = 1; match < 0 && n < tournament->threads; n++) {
+        MatchQueue* victim = &tournament->queues[(id + n) %
+                tournament->threads];
+        pthread_mutex_lock(&victim->lock);
+        int end = victim->end, left = victim->end - victim->next;
+        victim->end -= (left + 1) / 2;
+        int start = victim->end;
+        pthread_mutex_unlock(&victim->lock);
+        if (left > 0) {
+            pthread_mutex_lock(&own->lock);
+            own->next = start + 1;
+            own->end = end;
+            pthread_mutex_unlock(&own->lock);
+            match = start;
         }
-        printf("\n");
     }
+    return match;
+}
+
+/*
+ * Play tournament games in one thread until there are none left
+ * Param: data - the TournamentWorker of the thread
+ * Return: NULL
+ */
+void* tournament_worker(void* data) {
+    TournamentWorker* worker = (TournamentWorker*) data;
+    Tournament* tournament = worker->tournament;
+    for (int match = take_match(tournament, worker->id); match >= 0;
+            match = take_match(tournament, worker->id)) {
+        play_match(tournament->tiles, &tournament->matches[match]);
+    }
+    return NULL;
 }
 
 /*
- * Print every tile with its rotations
- * Param: tiles - all tiles to print
+ * Split a comma separated list in place
+ * Param: list - the list to split
+ *        items - set to a new array of the items
+ * Return: the number of items
  */
-void print_all_tiles(AllTiles* tiles) {
-    for (int i = 0; i < tiles->size; i++) {
-        print_tile(&(tiles->allTiles[i]), 1);
-        if (i < tiles->size - 1) {
-            printf("\n");
+int split_list(char* list, char*** items) {
+    int count = 1;
+    for (char* at = list; *at; at++) {
+        count += *at == ',';
+    }
+    *items = (char**) malloc(sizeof(char*) * count);
+    (*items)[0] = list;
+    for (int n = 1; *list; list++) {
+        if (*list == ',') {
+            *list = '\0';
+            (*items)[n++] = list + 1;
         }
     }
+    return count;
 }
 
 /*
- * Build a new empty board
- * Param: board - the board to build the empty grid in
+ * Run a tournament: every ordered pair of the player types plays the given
+ * number of games on every board size, each game starting from the next
+ * tile. Games are spread over a work-stealing pool of one thread per core.
+ * Param: tiles - collection of all tiles
+ *        argc, argv - the arguments after "--tournament": the number of
+ *                     games, then optionally a comma separated list of
+ *                     automatic player types (default "1,2") and a comma
+ *                     separated list of HEIGHTxWIDTH sizes (default "10x10")
+ * Error: exit at status 1, 4 or 5 for a bad game count, player type or size
  */
-void new_board(Board* board) {
-    board->grid = (char**) malloc(sizeof(char*) * board->height);
-    for (int row = 0; row < board->height; row++) {
-        board->grid[row] = (char*) malloc(sizeof(char) * board->width);
-        for (int column = 0; column < board->width; column++) {
-            board->grid[row][column] = BOARD_EMPTY;
+void tournament(AllTiles* tiles, int argc, char** argv) {
+    char defaultTypes[] = "1,2", defaultSizes[] = "10x10";
+    char** types;
+    char** sizes;
+    char next;
+    int games;
+    if (argc < 1 || argc > 3 || sscanf(argv[0], "%d%c", &games, &next) != 1 ||
+            games <= 0) {
+        fprintf(stderr, "Usage: fitz tilefile --tournament games [types");
+        fprintf(stderr, " [sizes]]\n");
+        exit(ERROR_ARG);
+    }
+    int typeCount = split_list(argc > 1 ? argv[1] : defaultTypes, &types);
+    int sizeCount = split_list(argc > 2 ? argv[2] : defaultSizes, &sizes);
+    for (int i = 0; i < typeCount; i++) {
+        Player player;
+        int error = check_player(types[i], &player);
+        free_player(&player);
+        check_error(error == ERROR_NONE && player.type == HUMAN ?
+                ERROR_PLAYER : error);
+    }
+    int* dims = (int*) malloc(sizeof(int) * 2 * sizeCount);
+    for (int i = 0; i < sizeCount; i++) {
+        if (sscanf(sizes[i], "%dx%d%c", &dims[2 * i], &dims[2 * i + 1],
+                &next) != 2 || dims[2 * i] <= 0 ||
+                dims[2 * i] >= BOARD_LIMIT || dims[2 * i + 1] <= 0 ||
+                dims[2 * i + 1] >= BOARD_LIMIT) {
+            check_error(ERROR_DIMS);
+        }
+    }
+    Tournament tournament;
+    int cells = typeCount * typeCount * sizeCount, total = cells * games;
+    tournament.tiles = tiles;
+    tournament.matches = (Match*) malloc(sizeof(Match) * total);
+    for (int n = 0; n < total; n++) {
+        Match* match = &tournament.matches[n];
+        int cell = n / games;
+        match->types[0] = types[cell / sizeCount / typeCount];
+        match->types[1] = types[cell / sizeCount % typeCount];
+        match->height = dims[2 * (cell % sizeCount)];
+        match->width = dims[2 * (cell % sizeCount) + 1];
+        match->start = n % games % tiles->size;
+    }
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    tournament.threads = threads < 1 ? 1 : threads > total ? total : threads;
+    tournament.queues = (MatchQueue*) malloc(sizeof(MatchQueue) *
+            tournament.threads);
+    TournamentWorker* workers = (TournamentWorker*) malloc(
+            sizeof(TournamentWorker) * tournament.threads);
+    double start = now_seconds();
+    for (int i = 0; i < tournament.threads; i++) {
+        // Each thread starts with an equal share of the games
+        pthread_mutex_init(&tournament.queues[i].lock, NULL);
+        tournament.queues[i].next = (long) total * i / tournament.threads;
+        tournament.queues[i].end = (long) total * (i + 1) /
+                tournament.threads;
+    }
+    for (int i = 0; i < tournament.threads; i++) {
+        workers[i].tournament = &tournament;
+        workers[i].id = i;
+        pthread_create(&workers[i].thread, NULL, tournament_worker,
+                &workers[i]);
+    }
+    for (int i = 0; i < tournament.threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        pthread_mutex_destroy(&tournament.queues[i].lock);
+    }
+    double seconds = now_seconds() - start;
+    for (int cell = 0; cell < cells; cell++) {
+        Match* match = &tournament.matches[cell * games];
+        long wins = 0, turns = 0;
+        for (int n = 0; n < games; n++) {
+            wins += match[n].winner == FIRST_PLAYER;
+            turns += match[n].turns;
         }
+        printf("%s vs %s %dx%d: %d games, %c wins %.1f%%, %c wins %.1f%%, "
+                "%.1f turns\n", match->types[0], match->types[1],
+                match->height, match->width, games, FIRST_TYPE,
+                100.0 * wins / games, SECOND_TYPE,
+                100.0 * (games - wins) / games, (double) turns / games);
+    }
+    printf("%d games in %.3f s, %.1f games/s on %d threads\n", total, seconds,
+            seconds > 0 ? total / seconds : 0.0, tournament.threads);
+    free(tournament.matches);
+    free(tournament.queues);
+    free(workers);
+    free(types);
+    free(sizes);
+    free(dims);
+}
+
+/*
+ * Solve the end of a saved game: print whether the player to move wins
+ * however the other plays, and with which move
+ * Param: tiles - collection of all tiles
+ *        argc, argv - the arguments after "--solve": the save file
+ * Error: exit at status 1 for a bad argument count, or as load_game() does
+ */
+void solve(AllTiles* tiles, int argc, char** argv) {
+    if (argc != 1) {
+        fprintf(stderr, "Usage: fitz tilefile --solve filename\n");
+        exit(ERROR_ARG);
     }
+    Game game;
+    Solution solution;
+    init_game(&game, tiles, "1", "1");
+    check_error(load_game(&game, argv[0]));
+    char type = game.order ? SECOND_TYPE : FIRST_TYPE;
+    int result = solve_endgame(&game.board, &game.tiles, game.tiles.current,
+            SOLVE_NODES, &solution);
+    printf("%d free cells in %d regions, %ld positions\n", solution.cells,
+            solution.regions, solution.nodes);
+    if (result == SOLVE_WIN) {
+        printf("Player %c wins with %d %d rotated %d\n", type,
+                solution.move.row, solution.move.column,
+                solution.move.rotation * 90);
+    } else if (result == SOLVE_LOSS) {
+        printf("Player %c loses\n", type);
+    } else {
+        printf("Too many free cells or positions to solve\n");
+    }
+    free_game(&game);
 }
 
 /*
- * Print the board.
- * Param: board - the board to print its grid
+ * Print a string as a JSON string
+ * Param: out - where to print it
+ *        text - the string
  */
-void print_board(Board* board) {
-    for (int i = 0; i < board->height; i++) {
-        for (int j = 0; j < board->width; j++) {
-            printf("%c", board->grid[i][j]);
+void print_json_string(FILE* out, char* text) {
+    fputc('"', out);
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') {
+            fprintf(out, "\\%c", *text);
+        } else if ((unsigned char) *text < ' ') {
+            fprintf(out, "\\u%04x", *text);
+        } else {
+            fputc(*text, out);
         }
-        printf("\n");
     }
+    fputc('"', out);
 }
 
 /*
- * Check whether the placement is valid
- * Param: tile - the tile to put
- *        board - the board to place the tile on
- *        row, column - where to place the tile on the board
- * Return: 1 if it is a valid placement; 0 if it is not.
+ * Print a move as a JSON array "[row,column,degrees]", or null for none
+ * Param: out - where to print it
+ *        move - the move; rotation -1 for none
  */
-int valid_place(char** tile, Board* board, int row, int column) {
-    int boardRow, boardColumn;
-    for (int i = 0; i < TILE_SIZE; i++) {
-        for (int j = 0; j < TILE_SIZE; j++) {
-            if (tile[i][j] == TILE_EXIST) {
-                // The position of '!' on the board
-                boardRow = row + i - MIDDLE;
-                boardColumn = column + j - MIDDLE;
-                if (boardRow < 0 || boardRow >= board->height ||
-                        boardColumn < 0 || boardColumn >= board->width) {
-                    // Off the board
-                    return 0;
-                } else if (board->grid[boardRow][boardColumn] != BOARD_EMPTY) {
-                    // Overlap
-                    return 0;
-                }
-            }
+void print_json_move(FILE* out, Move move) {
+    if (move.rotation < 0) {
+        fprintf(out, "null");
+    } else {
+        fprintf(out, "[%d,%d,%d]", move.row, move.column, move.rotation * 90);
+    }
+}
+
+/*
+ * Analyse a save file into one line of JSON: the size of the board, the
+ * legal placements of each rotation of the tile to place next and of the
+ * tile after, which the other player places, and what the automatic
+ * players would play next. A file that can't be loaded gives its error.
+ * Param: tiles - collection of all tiles
+ *        path - the save file
+ * Return: the line, ending in a newline, to be freed
+ */
+char* analyse_file(AllTiles* tiles, char* path) {
+    char* line = NULL;
+    size_t length = 0;
+    FILE* out = open_memstream(&line, &length);
+    Game game;
+    Analysis analysis;
+    init_game(&game, tiles, "1", "1");
+    int error = load_game(&game, path);
+    fprintf(out, "{\"file\":");
+    print_json_string(out, path);
+    if (error != ERROR_NONE) {
+        fprintf(out, ",\"error\":%d,\"message\":\"%s\"}\n", error,
+                error_message(error));
+    } else {
+        analyse_game(&game, &analysis);
+        fprintf(out, ",\"height\":%d,\"width\":%d", game.board.height,
+                game.board.width);
+        for (int k = 0; k < 2; k++) {
+            // The player to move, then the other player with the tile after
+            long* moves = analysis.moves[k];
+            fprintf(out, ",\"%s\":{\"player\":\"%c\",\"tile\":%d,"
+                    "\"moves\":[%ld,%ld,%ld,%ld],\"mobility\":%ld}",
+                    k ? "next" : "move",
+                    game.order ^ k ? SECOND_TYPE : FIRST_TYPE,
+                    (game.tiles.current + k) % game.tiles.size, moves[0],
+                    moves[1], moves[2], moves[3], analysis.mobility[k]);
         }
+        fprintf(out, ",\"auto1\":");
+        print_json_move(out, analysis.auto1);
+        fprintf(out, ",\"auto2\":");
+        print_json_move(out, analysis.auto2);
+        fprintf(out, "}\n");
     }
-    return 1;
+    fclose(out);
+    free_game(&game);
+    return line;
 }
 
 /*
- * Place the tile.
- * Param: tile - the tile to put
- *        board - the board to place the tile on
- *        row, column - where to put the tile on the board
- *        type - the pattern of the tile. FIRST_TYPE ('*') or SECOND_TYPE ('#')
+ * An analysis thread: analyse save files until none are left
+ * Param: data - the Analyses
+ * Return: NULL
  */
-void put_tile(char** tile, Board* board, int row, int column, char type) {
-    int boardRow, boardColumn;
-    for (int i = 0; i < TILE_SIZE; i++) {
-        for (int j = 0; j < TILE_SIZE; j++) {
-            if (tile[i][j] == TILE_EXIST) {
-                boardRow = row + i - MIDDLE;
-                boardColumn = column + j - MIDDLE;
-                board->grid[boardRow][boardColumn] = type;
-            }
+void* analysis_worker(void* data) {
+    Analyses* analyses = (Analyses*) data;
+    while (1) {
+        pthread_mutex_lock(&analyses->lock);
+        int n = analyses->next++;
+        pthread_mutex_unlock(&analyses->lock);
+        if (n >= analyses->count) {
+            return NULL;
         }
+        analyses->lines[n] = analyse_file(analyses->tiles, analyses->paths[n]);
+    }
+}
+
+/*
+ * Add a path to a list of paths
+ * Param: paths - the list, grown as needed
+ *        count - the number of paths in the list, counted up
+ *        path - the path to add, which the list takes
+ */
+void add_path(char*** paths, int* count, char* path) {
+    if ((*count & (*count - 1)) == 0) {
+        // Grown whenever the count reaches a power of two
+        *paths = (char**) realloc(*paths, sizeof(char*) * (*count ? 2 *
+                *count : 1));
     }
+    (*paths)[(*count)++] = path;
 }
 
 /*
- * Read a line from user input or a file
- * Param: file - pointer to a FILE object to read
- * Return: The line got from the stream
- * Error: Exit (10) if it reaches the end of file while waiting for user input
+ * Order two strings for qsort()
+ * Param: a, b - pointers to the strings
+ * Return: negative, zero or positive as a goes before, with or after b
  */
-char* read_line(FILE* file) {
-    int max = MAX, n = 0, next = fgetc(file);
-    char* buffer = (char*) malloc(sizeof(char) * max);
-    while (next != '\n') {
-        if (n >= max - 1) {
-            buffer = (char*) realloc(buffer, sizeof(char) * (n + 2));
-            max++;
+int compare_paths(const void* a, const void* b) {
+    return strcmp(*(char* const*) a, *(char* const*) b);
+}
+
+/*
+ * Add the save files named by an argument to a list: the files of a
+ * directory in name order, leaving out hidden ones, the paths on the lines
+ * of standard input for "-", or else the argument itself
+ * Param: paths, count - the list, as for add_path()
+ *        name - the argument
+ */
+void add_saves(char*** paths, int* count, char* name) {
+    struct stat status;
+    if (strcmp(name, "-") == 0) {
+        LineBuffer buffer = {NULL, 0};
+        for (char* line = read_line(stdin, &buffer); line != NULL;
+                line = read_line(stdin, &buffer)) {
+            if (line[0] != '\0') {
+                add_path(paths, count, strdup(line));
+            }
         }
-        if (next == EOF) {
-            fprintf(stderr, "End of input\n");
-            exit(EXIT_END_INPUT);
+        free(buffer.line);
+        return;
+    }
+    DIR* directory = stat(name, &status) == 0 && S_ISDIR(status.st_mode) ?
+            opendir(name) : NULL;
+    if (directory == NULL) {
+        add_path(paths, count, strdup(name));
+        return;
+    }
+    int first = *count;
+    for (struct dirent* entry = readdir(directory); entry != NULL;
+            entry = readdir(directory)) {
+        if (entry->d_name[0] != '.') {
+            size_t length = strlen(name) + strlen(entry->d_name) + 2;
+            char* path = (char*) malloc(length);
+            snprintf(path, length, "%s/%s", name, entry->d_name);
+            add_path(paths, count, path);
         }
-        buffer[n] = (char) next;
-        n++;
-        next = getc(file);
     }
-    buffer[n] = '\0';
-    return buffer;
+    closedir(directory);
+    qsort(*paths + first, *count - first, sizeof(char*), compare_paths);
 }
 
 /*
- * Get the rotated tile
- * Param: degrees - 0, 90, 180, or 270 degrees to rotate in
- *        currentTile - the original tile to rotate
- * Return: the rotated tile
+ * Analyse save files without playing them, printing one line of JSON for
+ * each in the order given. Files are spread over one thread per core.
+ * Param: tiles - collection of all tiles
+ *        argc, argv - the arguments after "--analyse": save files,
+ *                     directories of save files, or "-" for a list of save
+ *                     files on standard input
+ * Error: exit at status 1 if there are no arguments
  */
-char** rotate_tile(int degrees, Tile* currentTile) {
-    switch (degrees) {
-        case 0:
-            return currentTile->rotate0;
-        case 90:
-            return currentTile->rotate90;
-        case 180:
-            return currentTile->rotate180;
+void analyse(AllTiles* tiles, int argc, char** argv) {
+    if (argc < 1) {
+        fprintf(stderr, "Usage: fitz tilefile --analyse filename|directory|-");
+        fprintf(stderr, " ...\n");
+        exit(ERROR_ARG);
+    }
+    Analyses analyses = {tiles, NULL, NULL, 0, 0};
+    for (int i = 0; i < argc; i++) {
+        add_saves(&analyses.paths, &analyses.count, argv[i]);
+    }
+    analyses.lines = (char**) malloc(sizeof(char*) * (analyses.count + 1));
+    pthread_mutex_init(&analyses.lock, NULL);
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = threads < 1 ? 1 : threads > analyses.count ? analyses.count :
+            threads;
+    pthread_t* workers = (pthread_t*) malloc(sizeof(pthread_t) *
+            (threads + 1));
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, analysis_worker, &analyses);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
     }
-    return currentTile->rotate270;
+    for (int n = 0; n < analyses.count; n++) {
+        fputs(analyses.lines[n], stdout);
+        free(analyses.lines[n]);
+        free(analyses.paths[n]);
+    }
+    pthread_mutex_destroy(&analyses.lock);
+    free(analyses.lines);
+    free(analyses.paths);
+    free(workers);
 }
 
 /*
- * Check whether the current player (human or auto 1) can win in this turn
- * Param: currentTile - the tile to check possible placements of
- *        board - the board to play on
- *        currentPlayer - the player who will play in this turn if they can win
- *        anotherPlayer - the other player
- *        turn - the turn counts starting at 1
- *        human - the player is human or auto type 1
- * Return: 1 if no valid placements anymore i.e. the game ends.
- *         0 if there exists a possible valid placement and game continues
+ * Map a record file into memory and find its records
+ * Param: path - the record file
+ *        tiles - collection of all tiles, which the records must be of
+ *        records, count - the list of records, grown as needed, and the
+ *                         number in it, counted up
+ * Error: exit at status 8 if the file can't be read, or 9 if it doesn't
+ *        hold whole records of the tiles
  */
-int game_end1(Tile* currentTile, Board* board, Player* currentPlayer,
-        Player* anotherPlayer, int turn, int human) {
-    int degree = 0, row, col;
-    if (turn == 1) {
-        row = MIDDLE * (-1), col = MIDDLE * (-1);
-    } else {
-        // Most recent legal move by either player i.e. the other player
-        row = anotherPlayer->rowStart, col = anotherPlayer->colStart;
-    }
-    while (degree <= 270) {
-        char** tile = rotate_tile(degree, currentTile);
-        do {
-            if (valid_place(tile, board, row, col) == 1) {
-                if (!human) {
-                    currentPlayer->rowStart = row;
-                    currentPlayer->colStart = col;
-                    currentPlayer->validDegree = degree;
-                }
-                return 0; // Valid placement exists
-            }
-            col++;
+void map_records(char* path, AllTiles* tiles, Record** records,
+        long* count) {
+    int fd = open(path, O_RDONLY);
+    struct stat status;
+    if (fd < 0 || fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+        fprintf(stderr, "%s: %s\n", path, error_message(ERROR_ACCESS_RECORD));
+        exit(ERROR_ACCESS_RECORD);
+    }
+    size_t size = (size_t) status.st_size;
+    char* data = size ? (char*) mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd,
+            0) : NULL;
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", path, error_message(ERROR_ACCESS_RECORD));
+        exit(ERROR_ACCESS_RECORD);
+    }
+    // The mapping stays until the program ends, as the records point into it
+    madvise(data, size, MADV_SEQUENTIAL);
+    for (size_t at = 0; at < size; at += (*records)[(*count)++].size) {
+        if ((*count & (*count - 1)) == 0) {
+            // Grown whenever the count reaches a power of two
+            *records = (Record*) realloc(*records, sizeof(Record) *
+                    (*count ? 2 * *count : 1));
+        }
+        if (read_record(data + at, size - at, tiles, &(*records)[*count]) !=
+                ERROR_NONE) {
+            fprintf(stderr, "%s: %s\n", path,
+                    error_message(ERROR_RECORD_CONTENTS));
+            exit(ERROR_RECORD_CONTENTS);
+        }
+    }
+}
 
-            if (col > board->width + 1) {
-                col = MIDDLE * (-1);
-                row++; // Go to check the next row
-            }
-            if (row > board->height + 1) {
-                row = MIDDLE * (-1); // Back to the top
+/*
+ * A replay thread: replay blocks of records until none are left. A board
+ * of each size is kept empty, and copied to start every game of that size.
+ * Param: data - the Replays
+ * Return: NULL
+ */
+void* replay_worker(void* data) {
+    Replays* replays = (Replays*) data;
+    Board empty = {0}, board = {0};
+    long moves = 0, invalid = 0;
+    while (1) {
+        pthread_mutex_lock(&replays->lock);
+        long first = replays->next;
+        replays->next += REPLAY_BLOCK;
+        pthread_mutex_unlock(&replays->lock);
+        if (first >= replays->count) {
+            break;
+        }
+        long end = first + REPLAY_BLOCK < replays->count ?
+                first + REPLAY_BLOCK : replays->count;
+        for (long n = first; n < end; n++) {
+            Record* record = &replays->records[n];
+            if (record->height != empty.height ||
+                    record->width != empty.width) {
+                free_board(&empty);
+                free_board(&board);
+                empty.height = board.height = record->height;
+                empty.width = board.width = record->width;
+                new_board(&empty);
+                new_board(&board);
             }
-        } while (row != anotherPlayer->rowStart ||
-                col != anotherPlayer->colStart);
-        degree += 90;
+            copy_cells(&empty, &board);
+            long played = replay_record(record, replays->tiles, &board,
+                    record->moves);
+            moves += played;
+            invalid += played < record->moves;
+        }
     }
-    return 1;
+    free_board(&empty);
+    free_board(&board);
+    pthread_mutex_lock(&replays->lock);
+    replays->moves += moves;
+    replays->invalid += invalid;
+    pthread_mutex_unlock(&replays->lock);
+    return NULL;
 }
 
 /*
- * Check whether the current player (auto 2) can win in this turn
- * Param: currentTile - the tile to check possible placements of
- *        board - the board to play on
- *        currentPlayer - the player who will play in this turn if they can win
- * Return: 1 if no valid placements anymore i.e. the game ends.
- *         0 if there exists a possible valid placement and game continues
- */
-int game_end2(Tile* currentTile, Board* board, Player* player) {
-    int row = player->rowStart, col = player->colStart, degree;
-    do {
-        degree = 0;
-        while (degree <= 270) {
-            char** tile = rotate_tile(degree, currentTile);
-            if (valid_place(tile, board, row, col) == 1) {
-                player->rowStart = row;
-                player->colStart = col;
-                player->validDegree = degree;
-                return 0;
-            }
-            degree += 90;
-        }
-        if (player->order == 1) {
-            // The second player search from right to left, bottom to top
-            col--;
-            if (col < MIDDLE * (-1)) {
-                col = board->width + 1;
-                row--;
-            }
-            if (row < MIDDLE * (-1)) {
-                row = board->height + 1;
-            }
+ * Print the position after some moves of a record, in the text save format
+ * Param: tiles - collection of all tiles
+ *        record - the record
+ *        number - its number, for errors
+ *        moves - the moves to play; all of them if the record has fewer
+ * Error: exit at status 9 if a move doesn't fit
+ */
+void print_record(AllTiles* tiles, Record* record, long number, long moves) {
+    Board board;
+    board.height = record->height;
+    board.width = record->width;
+    new_board(&board);
+    moves = moves < record->moves ? moves : record->moves;
+    if (replay_record(record, tiles, &board, moves) < moves) {
+        fprintf(stderr, "Record %ld: %s\n", number,
+                error_message(ERROR_RECORD_CONTENTS));
+        exit(ERROR_RECORD_CONTENTS);
+    }
+    printf("%ld %ld %d %d\n", (record->tile + moves) % tiles->size,
+            (record->order + moves) % 2, board.height, board.width);
+    print_board(stdout, &board);
+    free_board(&board);
+}
+
+/*
+ * Replay game records without searching. Every record of the record files
+ * is played onto an empty board, spread over one thread per core, and how
+ * fast is printed. With "--at record[:moves]" only the position after some
+ * moves of one record is printed instead, in the text save format; the
+ * records are numbered from 0 through the files in order.
+ * Param: tiles - collection of all tiles
+ *        argc, argv - the arguments after "--replay": optionally --at, then
+ *                     record files, directories of record files, or "-"
+ *                     for a list of record files on standard input
+ * Error: exit at status 1 for bad arguments, or as map_records() does
+ */
+void replay(AllTiles* tiles, int argc, char** argv) {
+    long at = -1, moves = LONG_MAX;
+    char next;
+    if (argc >= 2 && strcmp(argv[0], "--at") == 0) {
+        int status = sscanf(argv[1], "%ld:%ld%c", &at, &moves, &next);
+        if ((status != 1 && status != 2) || at < 0 || moves < 0) {
+            at = -2;
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 1 || at < -1) {
+        fprintf(stderr, "Usage: fitz tilefile --replay [--at record[:moves]]");
+        fprintf(stderr, " filename|directory|- ...\n");
+        exit(ERROR_ARG);
+    }
+    double start = now_seconds();
+    Replays replays = {tiles, NULL, 0, 0, 0, 0};
+    char** paths = NULL;
+    int count = 0;
+    for (int i = 0; i < argc; i++) {
+        add_saves(&paths, &count, argv[i]);
+    }
+    for (int n = 0; n < count; n++) {
+        map_records(paths[n], tiles, &replays.records, &replays.count);
+        free(paths[n]);
+    }
+    free(paths);
+    if (at >= replays.count) {
+        fprintf(stderr, "There are only %ld records\n", replays.count);
+        exit(ERROR_ARG);
+    } else if (at >= 0) {
+        print_record(tiles, &replays.records[at], at, moves);
+        free(replays.records);
+        return;
+    }
+    pthread_mutex_init(&replays.lock, NULL);
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    long blocks = (replays.count + REPLAY_BLOCK - 1) / REPLAY_BLOCK;
+    threads = threads < 1 ? 1 : threads > blocks ? (blocks ? blocks : 1) :
+            threads;
+    pthread_t* workers = (pthread_t*) malloc(sizeof(pthread_t) * threads);
+    for (int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, replay_worker, &replays);
+    }
+    for (int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    double seconds = now_seconds() - start;
+    printf("%ld records, %ld with a move that doesn't fit\n", replays.count,
+            replays.invalid);
+    printf("%ld moves in %.3f s, %.0f moves/s on %ld threads\n",
+            replays.moves, seconds, seconds > 0 ? replays.moves / seconds :
+            0.0, threads);
+    pthread_mutex_destroy(&replays.lock);
+    free(replays.records);
+    free(workers);
+}
+
+/*
+ * Read an output mode
+ * Param: mode - "board", "cells" or "moves"
+ * Return: OUTPUT_BOARD, OUTPUT_CELLS or OUTPUT_MOVES, or -1 for none of these
+ */
+int output_mode(char* mode) {
+    if (strcmp(mode, "board") == 0) {
+        return OUTPUT_BOARD;
+    } else if (strcmp(mode, "cells") == 0) {
+        return OUTPUT_CELLS;
+    } else if (strcmp(mode, "moves") == 0) {
+        return OUTPUT_MOVES;
+    }
+    return -1;
+}
+
+/*
+ * Read the output mode given with --output
+ * Param: mode - "board", "cells" or "moves"
+ * Return: OUTPUT_BOARD, OUTPUT_CELLS or OUTPUT_MOVES
+ * Error: exit at status 1 if the mode is none of these
+ */
+int check_output(char* mode) {
+    int output = output_mode(mode);
+    if (output < 0) {
+        fprintf(stderr, "Invalid output mode\n");
+        exit(ERROR_ARG);
+    }
+    return output;
+}
+
+/*
+ * Open the stream given with --stats
+ * Param: fd - the number of a file descriptor open for writing, other than
+ *             stdout
+ * Return: the stream
+ * Error: exit at status 1 if it can't be written to, or the program was
+ *        built without FITZ_STATS
+ */
+FILE* check_stats(char* fd) {
+    FILE* stats = NULL;
+#ifdef FITZ_STATS
+    int number;
+    char next;
+    // Never stdout, so the game's own output stays as it is
+    if (sscanf(fd, "%d%c", &number, &next) == 1 && number >= 0 &&
+            number != STDOUT_FILENO) {
+        stats = fdopen(number, "w");
+    }
+    if (stats == NULL) {
+        fprintf(stderr, "Invalid stats descriptor\n");
+        exit(ERROR_ARG);
+    }
+#else
+    fprintf(stderr, "Stats are not built in: build with make STATS=1\n");
+    exit(ERROR_ARG);
+#endif
+    return stats;
+}
+
+/*
+ * Set up the game of a server session from the line starting it, which
+ * holds what fitz takes after the tile file: "[--output mode] p1type p2type"
+ * and then "height width" or a save file
+ * Param: session - the session
+ *        tiles - collection of all tiles, shared with the other sessions
+ *        line - the line, split up in place
+ *        out - where to print the board, or why the game can't be set up
+ * Return: 1 if the game is set up; 0 if not
+ */
+int start_session(Session* session, AllTiles* tiles, char* line, FILE* out) {
+    char* words[7];
+    char* rest = NULL;
+    int count = 0;
+    for (char* word = strtok_r(line, " ", &rest); word != NULL && count < 7;
+            word = strtok_r(NULL, " ", &rest)) {
+        words[count++] = word;
+    }
+    char** args = words;
+    session->output = OUTPUT_BOARD;
+    if (count >= 2 && strcmp(words[0], "--output") == 0) {
+        session->output = output_mode(words[1]);
+        args += 2;
+        count -= 2;
+    }
+    if (session->output < 0) {
+        fprintf(out, "Invalid output mode\n");
+        return 0;
+    }
+    if (count != 3 && count != 4) {
+        fprintf(out, "Usage: [--output mode] p1type p2type");
+        fprintf(out, " [height width | filename]\n");
+        return 0;
+    }
+    Game* game = &session->game;
+    int error = init_game(game, tiles, args[0], args[1]);
+    if (error == ERROR_NONE) {
+        // The workers already keep every core busy
+        game->players[0].threads = game->players[1].threads = 1;
+        if (count == 4) {
+            float height = atof(args[2]);
+            float width = atof(args[3]);
+            error = 0 < width && width < BOARD_LIMIT && 0 < height &&
+                    height < BOARD_LIMIT && (int) height == height &&
+                    (int) width == width ?
+                    start_game(game, (int) height, (int) width) : ERROR_DIMS;
         } else {
-            col++;
-            if (col > board->width + 1) {
-                col = MIDDLE * (-1);
-                row++;
-            }
-            if (row > board->height + 1) {
-                row = MIDDLE * (-1);
-            }
+            error = load_game(game, args[2]);
         }
-    } while (row != player->rowStart || col != player->colStart);
+        if (error != ERROR_NONE) {
+            free_game(game);
+        }
+    }
+    if (error != ERROR_NONE) {
+        fprintf(out, "%s\n", error_message(error));
+        return 0;
+    }
+    print_board(out, &game->board);
     return 1;
 }
 
 /*
- * An automatic player is playing. Put a tile if they can win.
- * Param: currentTile - the tile to be placed
- *        board - the board to play on
- *        currentPlayer - who will play or lose in this turn
- *        anotherPlayer - the other player
- *        turn - the turn counts starting at 1
- * Return: 1 if the game will end; 0 if it will continue
+ * Play a server session on from its line, as new_game() plays a game: the
+ * line starts the game or is a human player's input, and then turns are
+ * played up to a human player's prompt or the end of the game. What the
+ * game prints is kept as the session's reply.
+ * Param: session - the session, with its line
+ *        tiles - collection of all tiles, shared with the other sessions
  */
-int auto_turn(Tile* currentTile, Board* board, Player* currentPlayer,
-        Player* anotherPlayer, int turn) {
-    char type = currentPlayer->order ? SECOND_TYPE : FIRST_TYPE;
-    int end = 0;
-    if (currentPlayer->type == AUTO_1) {
-        end = game_end1(currentTile, board, currentPlayer, anotherPlayer, turn,
-                0);
+void play_session(Session* session, AllTiles* tiles) {
+    FILE* out = open_memstream(&session->reply, &session->replyLength);
+    Game* game = &session->game;
+    int waiting = 0;
+    if (!session->started) {
+        session->started = start_session(session, tiles, session->line, out);
     } else {
-        end = game_end2(currentTile, board, currentPlayer);
+        char type = game->order ? SECOND_TYPE : FIRST_TYPE;
+        Tile* tile = &(game->tiles.allTiles[game->tiles.current]);
+        int result = play_input(game, session->line);
+        if (result == INPUT_UNSAVED) {
+            fprintf(out, "Unable to save game\n");
+        }
+        if (result == INPUT_MOVED) {
+            print_turn(out, session->output, game, tile, type);
+        } else if (result == INPUT_UNDONE) {
+            // The player moves again from the position taken back to
+            print_board(out, &game->board);
+        } else {
+            fprintf(out, "Player %c] ", type);
+            waiting = 1;
+        }
     }
-
-    if (!end) {
-        // The game continues. Put the valid tile
-        printf("Player %c => %d %d rotated %d\n", type,
-                currentPlayer->rowStart, currentPlayer->colStart,
-                currentPlayer->validDegree);
-        char** tile = rotate_tile(currentPlayer->validDegree, currentTile);
-        put_tile(tile, board, currentPlayer->rowStart, currentPlayer->colStart,
-                type);
+    while (session->started && !waiting) {
+        Player* player = &game->players[game->order];
+        char type = game->order ? SECOND_TYPE : FIRST_TYPE;
+        Tile* tile = &(game->tiles.allTiles[game->tiles.current]);
+        if (choose_move(game)) {
+            fprintf(out, "Player %c wins\n",
+                    game->order ? FIRST_TYPE : SECOND_TYPE);
+            break;
+        }
+        if (player->type == HUMAN) {
+            print_tile(out, tile, 0);
+            fprintf(out, "Player %c] ", type);
+            waiting = 1;
+        } else {
+            fprintf(out, "Player %c => %d %d rotated %d\n", type,
+                    player->rowStart, player->colStart, player->validDegree);
+            play_move(game, player->rowStart, player->colStart,
+                    player->validDegree);
+            print_turn(out, session->output, game, tile, type);
+        }
     }
-    return end;
+    fclose(out);
+    session->after = waiting ? SESSION_INPUT : SESSION_OVER;
 }
 
 /*
- * Save the game into a file.
- * Param: path - the path of the file to save to
- *        tile - number next tile to play (starting from 0)
- *        player - the next player to have their turn (0 or 1)
- *        board - the board to play on
- * Error: print message and prompt again if there is error opening save file
+ * A server worker: play the turns of queued sessions until the server is
+ * killed, telling the server's thread about each one played
+ * Param: data - the Server
+ * Return: never
  */
-void save(char* path, int tile, int player, Board* board) {
-    FILE* outputFile = fopen(path, "w");
-    if (outputFile == NULL) {
-        fprintf(stderr, "Unable to save game\n");
-    } else {
-        fprintf(outputFile, "%d %d %d %d\n", tile, player, board->height,
-                board->width);
-        for (int i = 0; i < board->height; i++) {
-            for (int j = 0; j < board->width; j++) {
-                fprintf(outputFile, "%c", board->grid[i][j]);
-            }
-            fprintf(outputFile, "\n");
+void* server_worker(void* data) {
+    Server* server = (Server*) data;
+    uint64_t one = 1;
+    while (1) {
+        pthread_mutex_lock(&server->lock);
+        while (server->first == NULL) {
+            pthread_cond_wait(&server->ready, &server->lock);
+        }
+        Session* session = server->first;
+        server->first = session->next;
+        pthread_mutex_unlock(&server->lock);
+        play_session(session, server->tiles);
+        pthread_mutex_lock(&server->lock);
+        session->next = server->finished;
+        server->finished = session;
+        pthread_mutex_unlock(&server->lock);
+        while (write(server->wake, &one, sizeof(one)) < 0 && errno == EINTR) {
         }
-        fflush(outputFile);
-        fclose(outputFile);
     }
 }
 
 /*
- * Get the user input from the human player
- * Param: tiles - collection of all tiles
- *        board - the board to play on
- *        player - current human player
+ * Ask epoll for the events a session now needs: input until the client has
+ * sent it all, and room to write while there is output left
+ * Param: server - the server
+ *        session - the session
  */
-void human_turn(AllTiles* tiles, Board* board, Player* player) {
-    Tile* currentTile = &(tiles->allTiles[tiles->current]);
-    int loop = 1;
-    char type = player->order ? SECOND_TYPE : FIRST_TYPE;
-    while (loop) {
-        // Keep prompting until the input is valid
-        printf("Player %c] ", type);
-        char* buffer = read_line(stdin);
-        int num[3] = {0};
-        char next;
-        char firstFour[5];
-        if (buffer[0] != ' ') {
-            strncpy(firstFour, buffer, 4);
-            firstFour[4] = '\0';
-
-            if (strcmp(firstFour, "save") == 0) {
-                // Save games
-                save(buffer + 4, tiles->current, player->order, board);
-            } else {
-                int status = sscanf(buffer, "%d%d%d%c", &num[0], &num[1],
-                        &num[2], &next);
-                free(buffer);
-                if (status == 3) {
-                    // The input is three space separated integers
-                    int row = num[0], column = num[1], degree = num[2];
-
-                    if (degree == 0 || degree == 90 || degree == 180 ||
-                            degree == 270) {
-                        // Valid degree
-                        char** tile = rotate_tile(degree, currentTile);
-                        if (valid_place(tile, board, row, column) == 1) {
-                            // Valid placement
-                            put_tile(tile, board, row, column, type);
-                            player->rowStart = row;
-                            player->colStart = column;
-                            loop = 0; // Valid input. Stop prompting
-                        }
-                    }
-                }
-            }
+void watch_session(Server* server, Session* session) {
+    int events = (session->ended ? 0 : EPOLLIN) |
+            (session->outStart < session->outLength ? EPOLLOUT : 0);
+    struct epoll_event event = {0};
+    event.events = events;
+    event.data.ptr = session;
+    if (session->failed || events == 0) {
+        if (session->watched) {
+            epoll_ctl(server->epoll, EPOLL_CTL_DEL, session->fd, NULL);
         }
+    } else if (events != session->watched) {
+        epoll_ctl(server->epoll, session->watched ? EPOLL_CTL_MOD :
+                EPOLL_CTL_ADD, session->fd, &event);
     }
+    session->watched = session->failed ? 0 : events;
 }
 
 /*
- * A new turn. Put a tile or wait for user input if the player can win.
- * Param: tiles - collection of all tiles
- *        currentPlayer - who will play or lose in this turn
- *        anotherPlayer - the other player
- *        board - the board to play on
- *        turn - the turn counts starting at 1
- * Return: 1 if the player will lose (i.e. game will end) in this turn
- *         0 otherwise. The player can win and start playing
- */
-int new_turn(AllTiles* tiles, Player* currentPlayer, Player* anotherPlayer,
-        Board* board, int turn) {
-    Tile* currentTile = &(tiles->allTiles[tiles->current]);
-    int end = 0;
-    if (currentPlayer->type == HUMAN) {
-        if (!game_end1(currentTile, board, currentPlayer, currentPlayer, turn,
-                1)) {
-            print_tile(currentTile, 0);
-            human_turn(tiles, board, currentPlayer);
-        } else {
-            end = 1;
+ * Close a session's connection. The session is freed once the events in
+ * hand are handled, as some may still be for it.
+ * Param: server - the server
+ *        session - the session, not with a worker
+ */
+void close_session(Server* server, Session* session) {
+    session->ended = session->failed = 1;
+    watch_session(server, session);
+    close(session->fd);
+    session->fd = -1;
+    session->next = server->closed;
+    server->closed = session;
+}
+
+/*
+ * Free the sessions closed while handling the events in hand
+ * Param: server - the server
+ */
+void free_sessions(Server* server) {
+    while (server->closed != NULL) {
+        Session* session = server->closed;
+        server->closed = session->next;
+        if (session->started) {
+            free_game(&session->game);
         }
+        free(session->in);
+        free(session->out);
+        free(session);
+    }
+}
+
+/*
+ * Hand a session's next line to the workers, if it waits for one and a
+ * whole line has been read
+ * Param: server - the server
+ *        session - the session
+ */
+void take_line(Server* server, Session* session) {
+    char* end = session->state == SESSION_NEW ||
+            session->state == SESSION_INPUT ?
+            memchr(session->in, '\n', session->inLength) : NULL;
+    if (end == NULL || session->failed) {
+        return;
+    }
+    size_t length = (size_t) (end - session->in);
+    session->line = (char*) malloc(length + 1);
+    memcpy(session->line, session->in, length);
+    session->line[length] = '\0';
+    session->inLength -= length + 1;
+    memmove(session->in, end + 1, session->inLength);
+    session->state = SESSION_BUSY;
+    session->next = NULL;
+    pthread_mutex_lock(&server->lock);
+    if (server->first == NULL) {
+        server->first = session;
     } else {
-        end = auto_turn(currentTile, board, currentPlayer, anotherPlayer,
-                turn);
+        server->last->next = session;
     }
-    return end;
+    server->last = session;
+    pthread_cond_signal(&server->ready);
+    pthread_mutex_unlock(&server->lock);
 }
 
 /*
- * Set the player's initial legal play position
- * The second player who is auto type 2 starts at the bottom right corner
- *      (board rows + 2, board columns + 2);
- * Others (human player, auto type 1, the first auto 2) starts at the top left
- *      (-2, -2)
+ * Move a session on after something happened to it: hand on its next line,
+ * close it once it is over and all written, or else watch for what it needs
+ * next. A session waiting for a line the client will never send is over.
+ * Param: server - the server
+ *        session - the session
  */
-void set_start(Board* board, Player* player) {
-    if (player->type == AUTO_2 && player->order == 1) {
-        player->rowStart = board->height + MIDDLE;
-        player->colStart = board->width + MIDDLE;
+void settle_session(Server* server, Session* session) {
+    take_line(server, session);
+    if (session->state != SESSION_BUSY && (session->failed ||
+            (session->outStart == session->outLength &&
+            (session->state == SESSION_OVER || session->ended)))) {
+        close_session(server, session);
     } else {
-        player->rowStart = player->colStart = MIDDLE * (-1);
+        watch_session(server, session);
     }
 }
 
 /*
- * Start a new game
- * Param: board - the board to play on
- *        tiles - collection of all tiles
- *        player1 - the first player
- *        player2 - the second player
- *        order - the player (0 or 1) who starts to play.
- *                Read from a saved file or 0 for a new game
+ * Read what a client has sent, until there is no more for now. The end of
+ * the connection, or an error, ends its input.
+ * Param: session - the session
  */
-void new_game(Board* board, AllTiles* tiles, Player* player1, Player* player2,
-        int order) {
-    print_board(board);
-    set_start(board, player1);
-    set_start(board, player2);
-    int turn = 1, end = 0;
-    while (1) {
-        end = order ? new_turn(tiles, player2, player1, board, turn) :
-                new_turn(tiles, player1, player2, board, turn);
-        if (end) {
-            char preType = order ? FIRST_TYPE : SECOND_TYPE;
-            printf("Player %c wins\n", preType);
+void read_session(Session* session) {
+    while (!session->ended) {
+        if (session->inMax - session->inLength < READ_CHUNK) {
+            session->inMax *= 2;
+            session->in = (char*) realloc(session->in, session->inMax);
+        }
+        ssize_t n = read(session->fd, session->in + session->inLength,
+                session->inMax - session->inLength);
+        if (n > 0) {
+            session->inLength += (size_t) n;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
             return;
         } else {
-            print_board(board);
-            tiles->current++;
-            turn++;
-            if (tiles->current >= tiles->size) {
-                // Run out of tiles. Start again at the beginning
-                tiles->current = 0;
-            }
-            order = order ? FIRST_PLAYER : SECOND_PLAYER;
+            session->ended = 1;
         }
     }
 }
 
 /*
- * Load the board from the save file
- * Param: board - the board to play on
- *        file - the save file to get the board from
- * Return: 1 if successfully loaded. Return 0 otherwise
+ * Write as much of a session's output as the connection takes for now
+ * Param: session - the session
  */
-int load_board(Board* board, FILE* file) {
-    int row = 0, column = 0, next = 0;
-    next = fgetc(file);
-    while (next != EOF) {
-        column = 0;
-        while (next != '\n') {
-            if (row < board->height && column < board->width &&
-                    (next == FIRST_TYPE || next == SECOND_TYPE ||
-                    next == BOARD_EMPTY)) {
-                board->grid[row][column] = (char) next;
-                column++;
-                next = fgetc(file);
-            } else {
-                return 0;
-            }
-        }
-        if (column != board->width) {
-            return 0;
+void write_session(Session* session) {
+    while (session->outStart < session->outLength && !session->failed) {
+        ssize_t n = send(session->fd, session->out + session->outStart,
+                session->outLength - session->outStart, MSG_NOSIGNAL);
+        if (n > 0) {
+            session->outStart += (size_t) n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else if (n >= 0 || errno != EINTR) {
+            // The client has gone: nothing more will reach it
+            session->failed = session->ended = 1;
         }
-        row++;
-        next = fgetc(file);
     }
-    if (row != board->height) {
-        return 0;
-    }
-    return 1;
+    session->outStart = session->outLength = 0;
 }
 
 /*
- * Load the game from the save file
- * Param: filename - the filename got from the command line
- *        tiles - collection of all tiles
- *        board - the board to play on
- *        player1 - the first player
- *        player2 - the second player
- * Error: exit at status 6 if the save file can't be read
- *        exit at status 7 if the file contents are invalid
+ * Take the sessions the workers have finished playing, queue their replies
+ * for writing and move them on
+ * Param: server - the server
  */
-void load_game(char* filename, AllTiles* tiles, Board* board, Player* player1,
-        Player* player2) {
-    FILE* file = fopen(filename, "r");
-    if (file == NULL) {
-        fprintf(stderr, "Can't access save file\n");
-        exit(EXIT_ACCESS_SAVE);
+void finish_sessions(Server* server) {
+    uint64_t count;
+    while (read(server->wake, &count, sizeof(count)) < 0 && errno == EINTR) {
     }
-    char* firstLine = read_line(file);
-    int num[4];
-    char next;
-    int status = sscanf(firstLine, "%d%d%d%d%c", &num[0], &num[1], &num[2],
-            &num[3], &next);
-    int success = 0;
-    if (status == 4) {
-        int current = num[0], order = num[1];
-        board->height = num[2];
-        board->width = num[3];
-        new_board(board);
-        if (current < tiles->size && (order == 0 || order == 1) &&
-                load_board(board, file) == 1) {
-            success = 1;
-            tiles->current = current;
-            new_game(board, tiles, player1, player2, order);
-        }
-    }
-    if (!success) {
-        fprintf(stderr, "Invalid save file contents\n");
-        exit(EXIT_SAVE_CONTENTS);
-    }
-    fclose(file);
-}
-
-/*
- * Check and decide the player type
- * Param: type - the type got from the command line
- *        player - whose type needs to be defined
- * Error: Exit at status 4 if the type is invalid i.e. not 'h', '1', nor '2'.
- */
-void check_player(char* type, Player* player) {
-    if (strcmp(type, "h") == 0) {
-        player->type = HUMAN;
-    } else if (strcmp(type, "1") == 0) {
-        player->type = AUTO_1;
-    } else if (strcmp(type, "2") == 0) {
-        player->type = AUTO_2;
-    } else {
-        fprintf(stderr, "Invalid player type\n");
-        exit(EXIT_PLAYER);
+    pthread_mutex_lock(&server->lock);
+    Session* finished = server->finished;
+    server->finished = NULL;
+    pthread_mutex_unlock(&server->lock);
+    while (finished != NULL) {
+        Session* session = finished;
+        finished = session->next;
+        session->state = session->after;
+        free(session->line);
+        session->line = NULL;
+        if (!session->failed) {
+            if (session->outStart > 0) {
+                memmove(session->out, session->out + session->outStart,
+                        session->outLength - session->outStart);
+                session->outLength -= session->outStart;
+                session->outStart = 0;
+            }
+            session->out = (char*) realloc(session->out,
+                    session->outLength + session->replyLength + 1);
+            memcpy(session->out + session->outLength, session->reply,
+                    session->replyLength);
+            session->outLength += session->replyLength;
+            write_session(session);
+        }
+        free(session->reply);
+        session->reply = NULL;
+        settle_session(server, session);
     }
 }
 
 /*
- * Free the dynamic array built in Tile and AllTiles
- * Param: tiles - the collection of all tiles
+ * Start a session for every connection waiting to be accepted
+ * Param: server - the server
  */
-void free_tiles(AllTiles* tiles) {
-    for (int size = 0; size < tiles->size; size++) {
-        for (int row = 0; row < TILE_SIZE; row++) {
-            free(tiles->allTiles[size].rotate0[row]);
-            free(tiles->allTiles[size].rotate90[row]);
-            free(tiles->allTiles[size].rotate180[row]);
-            free(tiles->allTiles[size].rotate270[row]);
+void accept_sessions(Server* server) {
+    while (1) {
+        int fd = accept(server->listener, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            return;
         }
-        free(tiles->allTiles[size].rotate0);
-        free(tiles->allTiles[size].rotate90);
-        free(tiles->allTiles[size].rotate180);
-        free(tiles->allTiles[size].rotate270);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        Session* session = (Session*) calloc(1, sizeof(Session));
+        session->fd = fd;
+        session->state = SESSION_NEW;
+        session->inMax = READ_CHUNK;
+        session->in = (char*) malloc(session->inMax);
+        watch_session(server, session);
     }
-    free(tiles->allTiles);
 }
 
 /*
- * Free the dynamic array grid in Board
- * Param: board - whose grid to be freed
+ * Serve games over a Unix domain socket until killed. Each connection is a
+ * session: its first line is what fitz takes after the tile file, as in
+ * "p1type p2type height width", and after that it sends what a human player
+ * would type. It gets back what fitz would print, and is closed when the
+ * game ends. One thread waits on every connection with epoll, and a pool of
+ * workers plays the turns.
+ * Param: tiles - collection of all tiles, shared by every session
+ *        argc, argv - the arguments after "--serve": the path of the socket,
+ *                     then optionally the number of workers (default one
+ *                     per core)
+ * Error: exit at status 1 for bad arguments or a socket that can't be
+ *        listened on
  */
-void free_board(Board* board) {
-    for (int i = 0; i < board->height; i++) {
-        free(board->grid[i]);
+void serve(AllTiles* tiles, int argc, char** argv) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cores < 1 ? 1 : (int) cores;
+    char next;
+    struct sockaddr_un address = {0};
+    if (argc < 1 || argc > 2 || strlen(argv[0]) >= sizeof(address.sun_path) ||
+            (argc == 2 && (sscanf(argv[1], "%d%c", &threads, &next) != 1 ||
+            threads <= 0))) {
+        fprintf(stderr, "Usage: fitz tilefile --serve socket [threads]\n");
+        exit(ERROR_ARG);
+    }
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, argv[0]);
+    struct stat status;
+    if (stat(argv[0], &status) == 0 && S_ISSOCK(status.st_mode)) {
+        // Left by an earlier server
+        unlink(argv[0]);
+    }
+    Server server = {tiles};
+    server.listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+            SOCK_CLOEXEC, 0);
+    if (server.listener < 0 || bind(server.listener,
+            (struct sockaddr*) &address, sizeof(address)) < 0 ||
+            listen(server.listener, SOMAXCONN) < 0) {
+        fprintf(stderr, "Unable to listen on %s\n", argv[0]);
+        exit(ERROR_ARG);
+    }
+    server.epoll = epoll_create1(EPOLL_CLOEXEC);
+    server.wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = &server.listener;
+    epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.listener, &event);
+    event.data.ptr = &server.wake;
+    epoll_ctl(server.epoll, EPOLL_CTL_ADD, server.wake, &event);
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.ready, NULL);
+    for (int i = 0; i < threads; i++) {
+        pthread_t worker;
+        pthread_create(&worker, NULL, server_worker, &server);
+        pthread_detach(worker);
+    }
+    printf("Serving on %s with %d threads\n", argv[0], threads);
+    fflush(stdout);
+    struct epoll_event events[SERVER_EVENTS];
+    while (1) {
+        int count = epoll_wait(server.epoll, events, SERVER_EVENTS, -1);
+        for (int i = 0; i < count; i++) {
+            Session* session = (Session*) events[i].data.ptr;
+            if (events[i].data.ptr == &server.listener) {
+                accept_sessions(&server);
+            } else if (events[i].data.ptr == &server.wake) {
+                finish_sessions(&server);
+            } else if (session->fd >= 0) {
+                // Closed sessions stay until free_sessions(), unwatched
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    read_session(session);
+                }
+                write_session(session);
+                settle_session(&server, session);
+            }
+        }
+        free_sessions(&server);
     }
-    free(board->grid);
 }
 
-int main(int argc, char** argv) {
-    // Incorrect number of arguments. Exit at status 1
-    if (argc != 6 && argc != 5 && argc != 2) {
-        fprintf(stderr, "Usage: fitz tilefile [p1type p2type");
+int FITZ_MAIN(int argc, char** argv) {
+    char* tileFile = argv[argc > 1];
+    char* journalBase = NULL;
+    char* record = NULL;
+    FILE* stats = NULL;
+    int output = OUTPUT_BOARD, recover = 0;
+    while (argc >= 4 && (strcmp(argv[2], "--output") == 0 ||
+            strcmp(argv[2], "--journal") == 0 ||
+            strcmp(argv[2], "--recover") == 0 ||
+            strcmp(argv[2], "--stats") == 0 ||
+            strcmp(argv[2], "--record") == 0)) {
+        // Options go before the players: drop them from the rest
+        if (strcmp(argv[2], "--output") == 0) {
+            output = check_output(argv[3]);
+        } else if (strcmp(argv[2], "--stats") == 0) {
+            stats = check_stats(argv[3]);
+        } else if (strcmp(argv[2], "--record") == 0) {
+            record = argv[3];
+        } else {
+            recover = strcmp(argv[2], "--recover") == 0;
+            journalBase = argv[3];
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    int tournamentMode = argc >= 3 && strcmp(argv[2], "--tournament") == 0;
+    int solveMode = argc >= 3 && strcmp(argv[2], "--solve") == 0;
+    int analyseMode = argc >= 3 && strcmp(argv[2], "--analyse") == 0;
+    int serveMode = argc >= 3 && strcmp(argv[2], "--serve") == 0;
+    int replayMode = argc >= 3 && strcmp(argv[2], "--replay") == 0;
+    // Incorrect number of arguments. Exit at status 1. A recovered game
+    // comes from its journal rather than a size or save file
+    if (recover ? argc != 4 : argc != 6 && argc != 5 && argc != 2 &&
+            !tournamentMode && !solveMode && !analyseMode && !serveMode &&
+            !replayMode) {
+        fprintf(stderr, "Usage: fitz tilefile [options] [p1type p2type");
         fprintf(stderr, " [height width | filename]]\n");
-        exit(EXIT_ARG);
+        fprintf(stderr, "       fitz tilefile --tournament games [types");
+        fprintf(stderr, " [sizes]]\n");
+        fprintf(stderr, "       fitz tilefile --solve filename\n");
+        fprintf(stderr, "       fitz tilefile --analyse filename|directory|-");
+        fprintf(stderr, " ...\n");
+        fprintf(stderr, "       fitz tilefile --serve socket [threads]\n");
+        fprintf(stderr, "       fitz tilefile --replay [--at record[:moves]]");
+        fprintf(stderr, " filename|directory|- ...\n");
+        fprintf(stderr, "Options: --output board|cells|moves\n");
+        fprintf(stderr, "         --journal path | --recover path\n");
+        fprintf(stderr, "         --stats fd\n");
+        fprintf(stderr, "         --record path\n");
+        exit(ERROR_ARG);
+    }
+    AllTiles tiles;
+    check_error(load_tiles(tileFile, &tiles));
+    if (tournamentMode) {
+        tournament(&tiles, argc - 3, argv + 3);
+    } else if (solveMode) {
+        solve(&tiles, argc - 3, argv + 3);
+    } else if (analyseMode) {
+        analyse(&tiles, argc - 3, argv + 3);
+    } else if (serveMode) {
+        serve(&tiles, argc - 3, argv + 3);
+    } else if (replayMode) {
+        replay(&tiles, argc - 3, argv + 3);
+    } else if (argc == 2) {
+        print_all_tiles(stdout, &tiles); // Output the tile file contents
     } else {
-        FILE* file = fopen(argv[1], "r");
-        if (file == NULL) {
-            // The file can't be read. Exit at status 2
-            fprintf(stderr, "Can't access tile file\n");
-            exit(EXIT_ACCESS_TILE);
-        }
-        AllTiles tiles;
-        tiles.current = 0;
-        read_file(file, &tiles);
-        fclose(file);
-        if (argc == 2) {
-            print_all_tiles(&tiles); // Output the tile file contents
+        Game game;
+        check_error(init_game(&game, &tiles, argv[2], argv[3]));
+        game.players[FIRST_PLAYER].report = stderr;
+        game.players[SECOND_PLAYER].report = stderr;
+        if (record != NULL && (recover || argc != 6)) {
+            // A record is replayed from an empty board
+            fprintf(stderr, "Only new games can be recorded\n");
+            exit(ERROR_ARG);
+        }
+        Journal journal;
+        if (recover) {
+            check_error(recover_game(&game, &journal, journalBase,
+                    JOURNAL_LIMIT));
+        } else if (argc == 6) {
+            // Five args. Start a new game
+            float height = atof(argv[4]);
+            float width = atof(argv[5]);
+            // Height and width must be integers below BOARD_LIMIT
+            check_error(0 < width && width < BOARD_LIMIT && 0 < height &&
+                    height < BOARD_LIMIT && (int) height == height &&
+                    (int) width == width ?
+                    start_game(&game, (int) height, (int) width) :
+                    ERROR_DIMS);
         } else {
-            Player player1, player2;
-            check_player(argv[2], &player1);
-            player1.order = FIRST_PLAYER;
-            check_player(argv[3], &player2);
-            player2.order = SECOND_PLAYER;
-            Board board;
-            if (argc == 6) {
-                // Five args. Start a new game
-                float height = atof(argv[4]);
-                float width = atof(argv[5]);
-                if (0 < width && width < 999 && 0 < height && height < 999 &&
-                        (int) height == height && (int) width == width) {
-                    board.height = (int) height;
-                    board.width = (int) width;
-                    new_board(&board);
-                    new_game(&board, &tiles, &player1, &player2, FIRST_PLAYER);
-                } else {
-                    // Invalid height or width (not integers between 1 and 999)
-                    fprintf(stderr, "Invalid dimensions\n");
-                    exit(EXIT_DIMS); // status 5
-                }
-            } else {
-                //Four arguments. Load game from a save file
-                load_game(argv[4], &tiles, &board, &player1, &player2);
+            //Four arguments. Load game from a save file
+            check_error(load_game(&game, argv[4]));
+        }
+        if (journalBase != NULL && !recover) {
+            check_error(open_journal(&journal, &game, journalBase,
+                    JOURNAL_LIMIT));
+        }
+        new_game(&game, output, stats, record);
+        if (journalBase != NULL) {
+            if (journal.failed) {
+                fprintf(stderr, "Unable to write journal\n");
             }
-            free_board(&board);
+            close_journal(&journal);
         }
-        free_tiles(&tiles);
+        free_game(&game);
+    }
+    if (stats != NULL) {
+        fclose(stats);
     }
+    free_tiles(&tiles);
     return 0;
 }
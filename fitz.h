@@ -0,0 +1,326 @@
+#ifndef FITZ_H
+#define FITZ_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* Error codes. The command line program exits with them */
+#define ERROR_NONE 0
+#define ERROR_ARG 1
+#define ERROR_ACCESS_TILE 2
+#define ERROR_TILE_CONTENTS 3
+#define ERROR_PLAYER 4
+#define ERROR_DIMS 5
+#define ERROR_ACCESS_SAVE 6
+#define ERROR_SAVE_CONTENTS 7
+#define ERROR_ACCESS_RECORD 8
+#define ERROR_RECORD_CONTENTS 9
+#define ERROR_END_INPUT 10
+
+/* Results of a line of human input */
+#define INPUT_INVALID 0 // Not a legal move nor a save command
+#define INPUT_MOVED 1 // The move was played
+#define INPUT_SAVED 2 // The game was saved
+#define INPUT_UNSAVED 3 // The game couldn't be saved
+#define INPUT_UNDONE 4 // The player's last move was taken back
+
+#ifndef TILE_SIZE
+#define TILE_SIZE 5 // Tile size: each tile is described as a 5*5 grid. Build
+                    // with -DTILE_SIZE=N for N*N tiles, N from 2 to 8
+#endif
+#if TILE_SIZE < 2 || TILE_SIZE > 8
+#error "TILE_SIZE must be 2 to 8: a tile row is kept in a uint8_t"
+#endif
+#define MIDDLE (TILE_SIZE / 2) // The middle (@) of the 2D array tile is at
+                               // tile[MIDDLE][MIDDLE], i.e. [2][2] for 5*5
+#define AUTO_1 1
+#define AUTO_2 2
+#define HUMAN 3
+#define SEARCH 4
+#define MCTS 5
+#define ENDGAME 6
+#define FIRST_TYPE '*'
+#define SECOND_TYPE '#'
+#define BOARD_EMPTY '.'
+#define TILE_EMPTY ','
+#define TILE_EXIST '!'
+#define BOARD_LIMIT 250000 // Boards are smaller than this each way
+#define FIRST_PLAYER 0
+#define SECOND_PLAYER 1
+
+/* Results of the endgame solver */
+#define SOLVE_LOSS 0 // The player to move loses whatever they play
+#define SOLVE_WIN 1 // The player to move wins with the move found
+#define SOLVE_UNKNOWN 2 // Too many free cells or positions to solve
+
+/*
+ * Hot-path counts, indexes into what take_stats() fills in. They are only
+ * counted in builds with FITZ_STATS defined (make STATS=1).
+ */
+#define STAT_ANCHORS 0 // Anchors the scans looked at
+#define STAT_ROTATIONS 1 // Tile rotations the scans tried
+#define STAT_VALID 2 // valid_place() calls
+#define STAT_OFF_BOARD 3 // Of those, rejected for going off the board
+#define STAT_OVERLAP 4 // Of those, rejected for overlapping a tile
+#define STAT_COUNT 5
+
+/*
+ * A tile with its rotations. Each rotation is stored one bitmask per row:
+ * bit j of rotations[degree / 90][i] is set if tile[i][j] is '!'.
+ * Rotations that are the same as an earlier one, and tiles that are the same
+ * as an earlier tile, are noted so that they are only tried once.
+ */
+typedef struct {
+    uint8_t rotations[4][TILE_SIZE];
+    uint8_t same[4]; // The first rotation identical to each rotation
+    uint8_t bounds[4][4]; // Top, left, bottom and right '!' of each rotation;
+                          // top is TILE_SIZE for the empty tile
+    int shape; // Shared by identical tiles, numbered in order of appearance
+} Tile;
+
+/* Collection of all tiles */
+typedef struct {
+    int size; // Total number of tiles
+    int current; // Current tile (starting at 0)
+    Tile* allTiles;
+    uint64_t checksum; // Identifies the tile set in binary saves
+    int shapes; // Number of distinct tiles
+} AllTiles;
+
+/* A reusable buffer for reading lines of input */
+typedef struct {
+    char* line;
+    int max; // Space allocated for line, or 0 before the first line
+} LineBuffer;
+
+/*
+ * The anchors where every rotation of every tile can be placed, kept up to
+ * date as tiles are put on the board. Identical tiles and identical rotations
+ * of a tile share one map. The map of slot n holds one row of Board.stride
+ * words per anchor row, laid out as in legal_row(). The struct, its maps, its
+ * counts and its slots are one allocation.
+ */
+typedef struct {
+    AllTiles* tiles; // The tiles indexed
+    size_t mapSize; // Words in the map of one rotation
+    int slotCount; // Distinct rotations of distinct tiles
+    uint64_t* maps; // maps[n * mapSize]
+    long* counts; // counts[n]: number of legal anchors
+    uint8_t** rotations; // rotations[n]: the rotation mapped
+    int* slots; // slots[shape * 4 + r]: the slot of shape rotated r * 90
+} MoveIndex;
+
+/*
+ * The board to place tiles on. Cells are packed one bit per cell into rows of
+ * 64-bit words. The grid is surrounded by MARGIN cells on every side which are
+ * always occupied, so a tile hanging off the board is simply an overlap.
+ * Board cell (row, column) is bit (column + MARGIN) of padded row
+ * (row + MARGIN).
+ * A board too big to hold whole is sparse instead: its padded rows are cut
+ * into chunks one word wide, each allocated the first time one of its cells
+ * is set. A chunk never allocated is empty, and the margin is worked out
+ * rather than stored.
+ */
+typedef struct {
+    int height;
+    int width;
+    int stride; // Words per padded row, plus one so a window never overruns
+    uint64_t* occupied; // Set for placed tiles and the off-board margin;
+                        // NULL if the board is sparse
+    uint64_t* second; // Set for cells placed by the second player
+    uint64_t** chunks; // Chunks of a sparse board by chunk row and word, or
+                       // NULL if the board isn't sparse
+    MoveIndex* index; // Legal anchors of the tiles, or NULL if not built
+    uint64_t hash; // Zobrist hash of the occupied cells
+} Board;
+
+/* A placement of a tile */
+typedef struct {
+    int row;
+    int column;
+    int rotation; // Rotated rotation * 90 degrees
+} Move;
+
+/* What the endgame solver found out about a position */
+typedef struct {
+    int result; // SOLVE_WIN, SOLVE_LOSS or SOLVE_UNKNOWN
+    Move move; // The winning move, or else any legal move; rotation -1 if
+               // there is none or the position wasn't solved
+    int cells; // Free cells a tile can still go in
+    int regions; // Groups of those cells no placement spans two of
+    long nodes; // Positions solved
+} Solution;
+
+/* What analyse_game() found out about a position */
+typedef struct {
+    long moves[2][4]; // Legal anchors of each rotation of the tile to place
+                      // next, then of the tile after it
+    long mobility[2]; // Distinct placements of each: a rotation which
+                      // repeats an earlier one adds none
+    Move auto1; // What an AUTO_1 player would play next; rotation -1 if the
+                // tile fits nowhere
+    Move auto2; // Likewise for an AUTO_2 player
+} Analysis;
+
+/* Search state of a search player, private to the engine */
+typedef struct Search Search;
+
+/* Threads scanning huge boards, private to the engine */
+typedef struct ScanPool ScanPool;
+
+/* Player h, 1, or 2*/
+typedef struct {
+    int rowStart;
+    int colStart;
+    int validDegree;
+    int type; // AUTO_1 (1), AUTO_2 (2), HUMAN (3), SEARCH (4), MCTS (5) or
+              // ENDGAME (6)
+    int order; // FIRST_PLAYER (0) or SECOND_PLAYER (1)
+    LineBuffer input; // Reused for every line a human player enters
+    Search* search; // Used by SEARCH and ENDGAME players; NULL for others
+    long budget; // Playouts per move of an MCTS player, or milliseconds
+    int timed; // 1 if the MCTS budget is in milliseconds
+    FILE* report; // Where to report search statistics, or NULL
+    int threads; // Threads an AUTO_2 player scans huge boards with, 0 for
+                 // one per core
+    ScanPool* pool; // Those threads, started on the first huge scan, or NULL
+} Player;
+
+/*
+ * An append-only journal of the moves played since a snapshot of a game.
+ * The snapshot is a binary save at base.fzb and the journal is base.fzj: a
+ * header naming the snapshot it follows, then one record per move.
+ */
+typedef struct {
+    char* snapshot; // Path of the snapshot
+    char* path; // Path of the journal
+    FILE* file; // The journal, open for appending
+    uint64_t key; // Identifies the snapshot the records follow
+    long records; // Records since the snapshot
+    long limit; // Records to keep before compacting into a new snapshot
+    int failed; // 1 once a write has failed
+} Journal;
+
+/* A game record read from a record file, played from an empty board */
+typedef struct {
+    int height;
+    int width;
+    int tile; // The first tile played
+    int order; // The first player to move
+    long moves; // The number of moves
+    const uint64_t* packed; // The moves, packed as the record file has them
+    size_t size; // Bytes of the record in the file, header included
+} Record;
+
+/*
+ * A move played in a game, with what it changed besides the board, so that
+ * it can be taken back
+ */
+typedef struct {
+    int tile; // The tile played, the current tile before the move
+    int row;
+    int column;
+    int degrees;
+    int rowStart; // Where the mover's last move went before this one
+    int colStart;
+    int validDegree;
+} Played;
+
+/* The moves played in a game, oldest first */
+typedef struct {
+    Played* moves;
+    int count;
+    int max; // Space allocated for moves
+} History;
+
+/*
+ * One game: everything that changes as it is played. Games share nothing but
+ * the tiles, which they only read, so any number can be played at once. The
+ * board refers back to the game's tiles, so a game must stay where it is once
+ * it has been started or loaded.
+ */
+typedef struct {
+    AllTiles tiles; // The shared tiles, with this game's current tile
+    Board board;
+    Player players[2]; // Indexed by order
+    int order; // The player to move next
+    int turn; // The turn counts starting at 1
+    Journal* journal; // Where moves are recorded as they are played, or NULL
+    History history; // The moves played since the game was started or loaded
+} Game;
+
+/* Tiles */
+int parse_tiles(const char* text, size_t length, AllTiles* tiles);
+int read_file(FILE* file, AllTiles* tiles);
+int load_tiles(char* path, AllTiles* tiles);
+uint8_t* rotate_tile(int degrees, Tile* currentTile);
+int empty_tile(uint8_t* tile);
+void free_tiles(AllTiles* tiles);
+void print_tile(FILE* out, Tile* tile, int all);
+void print_all_tiles(FILE* out, AllTiles* tiles);
+
+/* Boards */
+void new_board(Board* board);
+void free_board(Board* board);
+void print_board(FILE* out, Board* board);
+void copy_cells(Board* from, Board* to);
+void print_cells(FILE* out, uint8_t* tile, int row, int column, char type);
+char get_cell(Board* board, int row, int column);
+void set_cell(Board* board, int row, int column, char type);
+void build_index(Board* board, AllTiles* tiles);
+int valid_place(uint8_t* tile, Board* board, int row, int column);
+void put_tile(uint8_t* tile, Board* board, int row, int column, char type);
+void take_tile(uint8_t* tile, Board* board, int row, int column);
+int has_move(Board* board, Tile* currentTile);
+ScanPool* new_scan_pool(int threads);
+void free_scan_pool(ScanPool* pool);
+long count_moves(Board* board, Tile* tile);
+
+/* Players */
+int check_player(char* type, Player* player);
+void set_start(Board* board, Player* player);
+int game_end1(Tile* currentTile, Board* board, Player* currentPlayer,
+        Player* anotherPlayer, int turn, int human);
+int game_end2(Tile* currentTile, Board* board, Player* player);
+int solve_endgame(Board* board, AllTiles* tiles, int current, long limit,
+        Solution* solution);
+void free_player(Player* player);
+
+/* Games */
+int init_game(Game* game, AllTiles* tiles, char* type1, char* type2);
+int start_game(Game* game, int height, int width);
+int load_game(Game* game, char* path);
+int choose_move(Game* game);
+void analyse_game(Game* game, Analysis* analysis);
+void play_move(Game* game, int row, int column, int degrees);
+int undo_move(Game* game);
+int undo_turn(Game* game);
+int replay_moves(Game* game, Move* moves, int count);
+int play_input(Game* game, char* line);
+int play_game(Game* game);
+void free_game(Game* game);
+
+/* Journals */
+int open_journal(Journal* journal, Game* game, char* base, long limit);
+int recover_game(Game* game, Journal* journal, char* base, long limit);
+void journal_move(Journal* journal, Game* game, int tile, int row, int column,
+        int degrees);
+void close_journal(Journal* journal);
+
+/* Records */
+int record_game(Game* game, char* path);
+int read_record(const void* data, size_t size, AllTiles* tiles,
+        Record* record);
+long replay_record(Record* record, AllTiles* tiles, Board* board,
+        long moves);
+
+/* Files and errors */
+char* read_line(FILE* file, LineBuffer* buffer);
+int save(char* path, AllTiles* tiles, int player, Board* board);
+int load_board(Board* board, FILE* file);
+char* error_message(int error);
+double now_seconds(void);
+char* engine_kernel(void);
+void take_stats(long* counts);
+
+#endif
@@ -0,0 +1,300 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include "fitz.h"
+
+#define LOAD_CLIENTS 16 // Sessions kept open at once by default
+#define LOAD_EVENTS 64 // Events taken from epoll at a time
+#define RECEIVE_CHUNK 4096 // Bytes received from a session at a time
+#define PROMPT_LENGTH 10 // Bytes of the prompt "Player *] "
+#define START_MAX 128 // Bytes of the line starting a session
+
+/*
+ * One session with the server. The client is the human first player, and
+ * plays the game alongside the server so that it knows the board: its own
+ * moves are the first automatic player's, and the other player's are read
+ * from the server.
+ */
+typedef struct {
+    int fd; // -1 when no session is open
+    Game game;
+    char* in; // Bytes received and not yet read
+    size_t inLength;
+    size_t inMax;
+    double sent; // When the last move was sent, or 0 if none is unanswered
+} Client;
+
+/* The load put on the server */
+typedef struct {
+    AllTiles* tiles;
+    char* path; // The server's socket
+    char start[START_MAX]; // The line starting each session
+    int height;
+    int width;
+    int epoll;
+    int started; // Sessions started so far
+    int sessions; // Sessions to play
+    int ended; // Sessions ended, played to the end or not
+    int failed; // Sessions the server ended early or played differently
+    double* latencies; // Seconds from each move sent to the server's answer
+    long moves;
+    long maxMoves;
+} Load;
+
+/*
+ * Open a session with the server and start its game
+ * Param: load - the load
+ *        client - the client, with no session open
+ * Return: 1 if the session is open; 0 if the server can't be reached
+ */
+int open_client(Load* load, Client* client) {
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, load->path, sizeof(address.sun_path) - 1);
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0 || connect(client->fd, (struct sockaddr*) &address,
+            sizeof(address)) < 0 || send(client->fd, load->start,
+            strlen(load->start), MSG_NOSIGNAL) < 0) {
+        if (client->fd >= 0) {
+            close(client->fd);
+        }
+        client->fd = -1;
+        return 0;
+    }
+    init_game(&client->game, load->tiles, "1", "1");
+    client->game.players[0].threads = client->game.players[1].threads = 1;
+    start_game(&client->game, load->height, load->width);
+    client->inLength = 0;
+    client->sent = 0;
+    struct epoll_event event = {0};
+    event.events = EPOLLIN;
+    event.data.ptr = client;
+    epoll_ctl(load->epoll, EPOLL_CTL_ADD, client->fd, &event);
+    load->started++;
+    return 1;
+}
+
+/*
+ * End a client's session, and start the next one in its place if there are
+ * more to play
+ * Param: load - the load
+ *        client - the client
+ *        failed - whether the session went wrong
+ * Return: 1 if the server can be reached for the next; 0 if not
+ */
+int close_client(Load* load, Client* client, int failed) {
+    epoll_ctl(load->epoll, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+    free_game(&client->game);
+    load->ended++;
+    load->failed += failed;
+    return load->started == load->sessions || open_client(load, client);
+}
+
+/*
+ * Note how long the server took to answer the last move, if one was sent
+ * Param: load - the load
+ *        client - the client the answer came to
+ */
+void answered(Load* load, Client* client) {
+    if (client->sent == 0) {
+        return;
+    }
+    if (load->moves == load->maxMoves) {
+        load->maxMoves = load->maxMoves ? load->maxMoves * 2 : 1024;
+        load->latencies = (double*) realloc(load->latencies,
+                sizeof(double) * load->maxMoves);
+    }
+    load->latencies[load->moves++] = now_seconds() - client->sent;
+    client->sent = 0;
+}
+
+/*
+ * Play the client's move at a prompt: the move the first automatic player
+ * would make
+ * Param: client - the client, prompted to move
+ * Return: 1 if the move was sent; 0 if the server prompted for a move the
+ *         client doesn't have, or it couldn't be sent
+ */
+int prompted(Client* client) {
+    Game* game = &client->game;
+    Player* player = &game->players[FIRST_PLAYER];
+    char line[64];
+    if (game->order != FIRST_PLAYER || choose_move(game)) {
+        return 0;
+    }
+    int length = snprintf(line, sizeof(line), "%d %d %d\n", player->rowStart,
+            player->colStart, player->validDegree);
+    play_move(game, player->rowStart, player->colStart, player->validDegree);
+    client->sent = now_seconds();
+    return send(client->fd, line, length, MSG_NOSIGNAL) == length;
+}
+
+/*
+ * Read what the server has sent a client, playing the client's moves when
+ * prompted and the other player's as they are read
+ * Param: load - the load
+ *        client - the client
+ * Return: 1 if the server can be reached for the next session; 0 if not
+ */
+int receive(Load* load, Client* client) {
+    int gone = 0;
+    while (!gone) {
+        if (client->inMax - client->inLength < RECEIVE_CHUNK) {
+            client->inMax = client->inMax ? client->inMax * 2 : RECEIVE_CHUNK;
+            client->in = (char*) realloc(client->in, client->inMax);
+        }
+        ssize_t n = recv(client->fd, client->in + client->inLength,
+                client->inMax - client->inLength, MSG_DONTWAIT);
+        if (n > 0) {
+            client->inLength += (size_t) n;
+            continue;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        gone = 1;
+    }
+    size_t at = 0;
+    while (1) {
+        char* line = client->in + at;
+        size_t left = client->inLength - at;
+        char* end = memchr(line, '\n', left);
+        char type;
+        int row, column, degrees;
+        if (left >= PROMPT_LENGTH && strncmp(line, "Player ", 7) == 0 &&
+                line[8] == ']') {
+            answered(load, client);
+            at += PROMPT_LENGTH;
+            if (!prompted(client)) {
+                return close_client(load, client, 1);
+            }
+        } else if (end == NULL) {
+            break;
+        } else {
+            *end = '\0';
+            at += (size_t) (end - line) + 1;
+            if (sscanf(line, "Player %c => %d %d rotated %d", &type, &row,
+                    &column, &degrees) == 4) {
+                play_move(&client->game, row, column, degrees);
+            } else if (strlen(line) == 13 && strcmp(line + 8, " wins") == 0) {
+                answered(load, client);
+                return close_client(load, client, 0);
+            }
+        }
+    }
+    client->inLength -= at;
+    memmove(client->in, client->in + at, client->inLength);
+    // The server ended the session before the game did
+    return gone ? close_client(load, client, 1) : 1;
+}
+
+/*
+ * Order two latencies for qsort()
+ * Param: a, b - pointers to the latencies
+ * Return: negative, zero or positive as a goes before, with or after b
+ */
+int compare_latencies(const void* a, const void* b) {
+    double x = *(const double*) a, y = *(const double*) b;
+    return (x > y) - (x < y);
+}
+
+/*
+ * Give a percentile of the sorted latencies in microseconds
+ * Param: load - the load, with its latencies sorted
+ *        fraction - the percentile as a fraction, from 0 to 1
+ * Return: the latency, or 0 if there are none
+ */
+double percentile(Load* load, double fraction) {
+    if (load->moves == 0) {
+        return 0;
+    }
+    return 1e6 * load->latencies[(long) (fraction * (load->moves - 1))];
+}
+
+/*
+ * Put load on a fitz server: play sessions against it as a human first
+ * player, keeping a number of them open at once, and print one JSON line of
+ * sessions played per second and percentiles of the time the server took to
+ * answer each move. Works with 5*5 tile files, as libfitz.a does.
+ */
+int main(int argc, char** argv) {
+    Load load = {0};
+    AllTiles tiles;
+    Player check;
+    char* type = argc > 5 ? argv[5] : "1";
+    char next;
+    int clients = LOAD_CLIENTS;
+    load.height = load.width = 10;
+    if (argc < 4 || argc > 7 || sscanf(argv[3], "%d%c", &load.sessions,
+            &next) != 1 || load.sessions <= 0 || (argc > 4 &&
+            (sscanf(argv[4], "%d%c", &clients, &next) != 1 || clients <= 0)) ||
+            (argc > 6 && sscanf(argv[6], "%dx%d%c", &load.height, &load.width,
+            &next) != 2)) {
+        fprintf(stderr, "Usage: fitz_load tilefile socket sessions [clients");
+        fprintf(stderr, " [p2type [HEIGHTxWIDTH]]]\n");
+        exit(ERROR_ARG);
+    }
+    int error = check_player(type, &check);
+    free_player(&check);
+    if (error != ERROR_NONE || check.type == HUMAN) {
+        fprintf(stderr, "%s\n", error_message(ERROR_PLAYER));
+        exit(ERROR_PLAYER);
+    }
+    if (load.height <= 0 || load.height >= BOARD_LIMIT || load.width <= 0 ||
+            load.width >= BOARD_LIMIT) {
+        fprintf(stderr, "%s\n", error_message(ERROR_DIMS));
+        exit(ERROR_DIMS);
+    }
+    error = load_tiles(argv[1], &tiles);
+    if (error != ERROR_NONE) {
+        fprintf(stderr, "%s\n", error_message(error));
+        exit(error);
+    }
+    load.tiles = &tiles;
+    load.path = argv[2];
+    snprintf(load.start, START_MAX, "--output moves h %s %d %d\n", type,
+            load.height, load.width);
+    load.epoll = epoll_create1(EPOLL_CLOEXEC);
+    clients = clients < load.sessions ? clients : load.sessions;
+    Client* all = (Client*) calloc(clients, sizeof(Client));
+    double start = now_seconds();
+    for (int i = 0; i < clients; i++) {
+        if (!open_client(&load, &all[i])) {
+            fprintf(stderr, "Unable to connect to %s\n", load.path);
+            exit(ERROR_ARG);
+        }
+    }
+    struct epoll_event events[LOAD_EVENTS];
+    while (load.ended < load.sessions) {
+        int count = epoll_wait(load.epoll, events, LOAD_EVENTS, -1);
+        for (int i = 0; i < count; i++) {
+            if (!receive(&load, (Client*) events[i].data.ptr)) {
+                fprintf(stderr, "Unable to connect to %s\n", load.path);
+                exit(ERROR_ARG);
+            }
+        }
+    }
+    double seconds = now_seconds() - start;
+    qsort(load.latencies, load.moves, sizeof(double), compare_latencies);
+    printf("{\"sessions\":%d,\"failed\":%d,\"clients\":%d,\"seconds\":%.3f,"
+            "\"sessions_per_s\":%.1f,\"moves\":%ld,\"p50_us\":%.1f,"
+            "\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+            load.sessions, load.failed, clients, seconds,
+            seconds > 0 ? load.sessions / seconds : 0.0, load.moves,
+            percentile(&load, 0.5), percentile(&load, 0.9),
+            percentile(&load, 0.99), percentile(&load, 1));
+    for (int i = 0; i < clients; i++) {
+        free(all[i].in);
+    }
+    free(all);
+    free(load.latencies);
+    free_tiles(&tiles);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <sys/stat.h>
+#include "fitz.h"
+
+#define SMALLEST_TILE 2 // The tile sizes fitz is built for, in the Makefile
+#define LARGEST_TILE 8
+
+/*
+ * fitz built with -DTILE_SIZE=N, where fitz_main_N() is its main(). Each
+ * build has its own engine, so the placement and scanning code of each size
+ * is compiled with the size as a constant.
+ */
+int fitz_main_2(int argc, char** argv);
+int fitz_main_3(int argc, char** argv);
+int fitz_main_4(int argc, char** argv);
+int fitz_main_5(int argc, char** argv);
+int fitz_main_6(int argc, char** argv);
+int fitz_main_7(int argc, char** argv);
+int fitz_main_8(int argc, char** argv);
+
+int (*const fitzMains[LARGEST_TILE + 1])(int, char**) = {
+    NULL, NULL, fitz_main_2, fitz_main_3, fitz_main_4, fitz_main_5,
+    fitz_main_6, fitz_main_7, fitz_main_8
+};
+
+/*
+ * Work out the tile size of a tile file from the length of its first line,
+ * as every row of a tile is as long as the tile is tall
+ * Param: path - the path of the tile file
+ * Return: the size, or TILE_SIZE if the file isn't a regular file (it could
+ *         only be read once) or its first line can't be a tile row. The
+ *         TILE_SIZE build then reports whatever is wrong with it.
+ */
+int tile_size(char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return TILE_SIZE;
+    }
+    struct stat status;
+    int size = 0, next = EOF;
+    if (fstat(fileno(file), &status) == 0 && S_ISREG(status.st_mode)) {
+        while (size <= LARGEST_TILE && (next = fgetc(file)) != EOF &&
+                next != '\n') {
+            size++;
+        }
+    }
+    fclose(file);
+    return next == '\n' && size >= SMALLEST_TILE && size <= LARGEST_TILE ?
+            size : TILE_SIZE;
+}
+
+int main(int argc, char** argv) {
+    // Options go after the tile file, so it is always the first argument
+    return fitzMains[argc > 1 ? tile_size(argv[1]) : TILE_SIZE](argc, argv);
+}